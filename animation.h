@@ -0,0 +1,227 @@
+#ifndef ANIMATION_H
+#define ANIMATION_H
+
+#include "camera.h"
+#include "image_io.h"
+#include "rtweekend.h"
+#include "transform.h"
+#include "vec3.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// Animated sequences: keyframed camera settings and instance placements, rendered frame after //
+// frame into one Camera so its thread pool and framebuffer are reused. Moving instances only //
+// refits the hierarchies above them, the trees built for the first frame are kept. //
+
+inline double lerp(double a, double b, double u){
+    return a + (b - a) * u;
+}
+
+inline Vec3 lerp(const Vec3& a, const Vec3& b, double u){
+    return a + real(u) * (b - a);
+}
+
+// Values at key times, linear in between and held before the first and after the last key //
+template <typename T>
+class Keyframes{
+    public:
+    struct Key{
+        double time;
+        T value;
+    };
+    std::vector<Key> keys; //sorted by time//
+
+    // A key at the time of an existing one replaces it //
+    void add(double time, const T& value){
+        auto at = std::lower_bound(keys.begin(), keys.end(), time, [](const Key& key, double t){
+            return key.time < t;
+        });
+        if(at != keys.end() && at->time == time){
+            at->value = value;
+        }else{
+            keys.insert(at, Key{time, value});
+        }
+    }
+
+    bool empty() const{
+        return keys.empty();
+    }
+
+    T at(double time) const{
+        if(time <= keys.front().time){
+            return keys.front().value;
+        }
+        if(time >= keys.back().time){
+            return keys.back().value;
+        }
+        auto next = std::upper_bound(keys.begin(), keys.end(), time, [](double t, const Key& key){
+            return t < key.time;
+        });
+        auto prev = next - 1;
+        return lerp(prev->value, next->value, (time - prev->time) / (next->time - prev->time));
+    }
+};
+
+// Where an animated object is on top of its rest transform: scaled, rotated about x, then y, //
+// then z by degrees, then translated. Kept apart so keys interpolate as motion, not as matrices. //
+struct Placement{
+    Vec3 translate = Vec3(0, 0, 0);
+    Vec3 rotate = Vec3(0, 0, 0);
+    Vec3 scale = Vec3(1, 1, 1);
+
+    Transform transform() const{
+        return Transform::translate(translate) * Transform::rotate(2, rotate[2]) * Transform::rotate(1, rotate[1])
+             * Transform::rotate(0, rotate[0]) * Transform::scale(scale);
+    }
+};
+
+inline Placement lerp(const Placement& a, const Placement& b, double u){
+    Placement p;
+    p.translate = lerp(a.translate, b.translate, u);
+    p.rotate = lerp(a.rotate, b.rotate, u);
+    p.scale = lerp(a.scale, b.scale, u);
+    return p;
+}
+
+// Placement keys of the instance-th instance added to a scene //
+struct Object_track{
+    size_t instance = 0;
+    Transform rest; //transform the instance was added with//
+    Keyframes<Placement> placement;
+};
+
+class Animation{
+    public:
+    int frames = 0; //no sequence when 0//
+    double start = 0, end = 1; //times of the first and last frame//
+    Keyframes<Point3> lookfrom;
+    Keyframes<Point3> lookat;
+    Keyframes<double> focus_dist;
+    std::vector<Object_track> objects;
+
+    bool empty() const{
+        return frames == 0 && lookfrom.empty() && lookat.empty() && focus_dist.empty() && objects.empty();
+    }
+
+    double frame_time(int frame) const{
+        return frames > 1 ? lerp(start, end, double(frame) / (frames - 1)) : start;
+    }
+
+    // Track of an instance, created with its rest transform the first time //
+    Object_track& object(size_t instance, const Transform& rest){
+        for(auto& track : objects){
+            if(track.instance == instance){
+                return track;
+            }
+        }
+        objects.push_back({instance, rest, {}});
+        return objects.back();
+    }
+
+    void apply(Camera& cam, double time) const{
+        if(!lookfrom.empty()) cam.lookfrom = lookfrom.at(time);
+        if(!lookat.empty()) cam.lookat = lookat.at(time);
+        if(!focus_dist.empty()) cam.focus_dist = focus_dist.at(time);
+    }
+
+    // Move the animated instances of a Scene or Static_scene, true when the scene needs a refit //
+    template <typename Scene_type>
+    bool apply(Scene_type& scene, double time) const{
+        bool moved = false;
+        for(const auto& track : objects){
+            if(track.placement.empty() || track.instance >= scene.instance_count()){
+                continue;
+            }
+            scene.set_instance_transform(track.instance, track.placement.at(time).transform() * track.rest);
+            moved = true;
+        }
+        return moved;
+    }
+};
+
+// frames frames of the camera circling its lookat about the vertical axis //
+inline Animation turntable(const Camera& cam, int frames){
+    Animation animation;
+    animation.frames = frames;
+    animation.start = 0;
+    animation.end = frames > 1 ? double(frames - 1) / frames : 0;
+    Vec3 offset = cam.lookfrom - cam.lookat;
+    // A key on every frame, interpolating between fewer would cut across the circle //
+    for(int k=0; k<frames; k++){
+        double time = double(k) / frames;
+        animation.lookfrom.add(time, cam.lookat + Transform::rotate(1, 360 * time).vector(offset));
+    }
+    return animation;
+}
+
+// Path of a frame: the last run of '#' in pattern becomes the zero padded frame number, without //
+// one the number goes before the extension //
+inline std::string frame_path(const std::string& pattern, int frame){
+    std::string number = std::to_string(frame);
+    size_t last = pattern.rfind('#');
+    if(last == std::string::npos){
+        size_t dot = pattern.rfind('.');
+        size_t slash = pattern.rfind('/');
+        if(dot == std::string::npos || (slash != std::string::npos && dot < slash)){
+            dot = pattern.size();
+        }
+        if(number.size() < 4) number.insert(0, 4 - number.size(), '0');
+        return pattern.substr(0, dot) + "_" + number + pattern.substr(dot);
+    }
+    size_t first = pattern.find_last_not_of('#', last);
+    first = first == std::string::npos ? 0 : first + 1;
+    size_t width = last + 1 - first;
+    if(number.size() < width) number.insert(0, width - number.size(), '0');
+    return pattern.substr(0, first) + number + pattern.substr(last + 1);
+}
+
+// Render every frame of animation to frame_path(pattern, frame) in cam.output_format, with the //
+// time spent updating the scene, rendering and writing each frame on std::clog //
+template <typename Scene_type>
+bool render_sequence(Scene_type& scene, Camera& cam, const Animation& animation, const std::string& pattern,
+                     std::string& error){
+    using clock = std::chrono::steady_clock;
+    auto ms = [](clock::duration d){
+        return std::chrono::duration<double, std::milli>(d).count();
+    };
+    bool quiet = cam.quiet;
+    cam.quiet = true;
+    auto sequence_start = clock::now();
+    for(int frame=0; frame<animation.frames; frame++){
+        auto start = clock::now();
+        double time = animation.frame_time(frame);
+        animation.apply(cam, time);
+        if(animation.apply(scene, time)){
+            scene.refit();
+        }
+        auto updated = clock::now();
+        cam.render_image(scene);
+        auto rendered = clock::now();
+        std::string path = frame_path(pattern, frame);
+        if(!write_image(cam.image(), cam.output_format, path)){
+            cam.quiet = quiet;
+            error = "cannot write " + path;
+            return false;
+        }
+        auto written = clock::now();
+        if(!quiet){
+            char line[160];
+            std::snprintf(line, sizeof(line), "Frame %d/%d: update %.2f ms, render %.1f ms, write %.1f ms\n",
+                          frame + 1, animation.frames, ms(updated - start), ms(rendered - updated), ms(written - rendered));
+            std::clog << line;
+        }
+    }
+    cam.quiet = quiet;
+    if(!quiet){
+        double total = ms(clock::now() - sequence_start);
+        std::clog << animation.frames << " frames in " << total / 1000 << " s, "
+                  << total / std::max(animation.frames, 1) << " ms per frame\n";
+    }
+    return true;
+}
+
+#endif
@@ -0,0 +1,663 @@
+#include "bvh.h"
+#include "camera.h"
+#include "hittable_list.h"
+#include "instance.h"
+#include "lights.h"
+#include "material.h"
+#include "onb.h"
+#include "ray_packet.h"
+#include "rtweekend.h"
+#include "scene.h"
+#include "scenes.h"
+#include "sphere.h"
+#include "sphere_set.h"
+#include "static_scene.h"
+#include "transform.h"
+#include "triangle_mesh.h"
+#include "vec3.h"
+#include <benchmark/benchmark.h>
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <typeindex>
+#include <vector>
+
+// Micro and full frame benchmarks of the renderer's hot paths, built on Google Benchmark. //
+// Ray queries report Mrays/s through the "rays" rate counter, samplers report items per second. //
+
+static void set_ray_rate(benchmark::State& state, double rays){
+    state.counters["rays"] = benchmark::Counter(rays, benchmark::Counter::kIsRate);
+}
+
+// -- Random numbers -- //
+
+static void BM_std_rand(benchmark::State& state){
+    for(auto _ : state){
+        benchmark::DoNotOptimize(std::rand() / (RAND_MAX / 1.0));
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_std_rand)->ThreadRange(1, 8);
+
+static void BM_mt19937(benchmark::State& state){
+    std::mt19937 generator;
+    std::uniform_real_distribution<double> distribution(0.0, 1.0);
+    for(auto _ : state){
+        benchmark::DoNotOptimize(distribution(generator));
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_mt19937);
+
+template <typename Generator>
+static void BM_generator(benchmark::State& state){
+    Generator rng(1, 0);
+    for(auto _ : state){
+        benchmark::DoNotOptimize(rng.next_double());
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK_TEMPLATE(BM_generator, Pcg32);
+BENCHMARK_TEMPLATE(BM_generator, Xoshiro256_plus);
+
+static void BM_random_double(benchmark::State& state){
+    seed_random(0, std::uint64_t(state.thread_index()));
+    for(auto _ : state){
+        benchmark::DoNotOptimize(random_double());
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_random_double)->ThreadRange(1, 8);
+
+// The camera's pattern: reseed per pixel sample, then draw a handful of numbers //
+static void BM_seed_per_sample(benchmark::State& state){
+    std::uint64_t sample = 0;
+    for(auto _ : state){
+        seed_random(mix_seed(0, sample), sample);
+        for(int d=0; d<8; d++){
+            benchmark::DoNotOptimize(random_double());
+        }
+        sample++;
+    }
+    state.SetItemsProcessed(state.iterations() * 8);
+}
+BENCHMARK(BM_seed_per_sample);
+
+// -- Samplers -- //
+
+// The rejection loops the closed-form maps replaced, for comparison //
+static Vec3 rejection_unit_vector(){
+    while(true){
+        auto p = Vec3::random(-1, 1);
+        auto lensq = p.length_squared();
+        if(real(1e-160) < lensq && lensq <= 1){
+            return p / std::sqrt(lensq);
+        }
+    }
+}
+
+static Vec3 rejection_unit_disk(){
+    while(true){
+        auto p = Vec3(real(random_double(-1, 1)), real(random_double(-1, 1)), 0);
+        if(p.length_squared() < 1){
+            return p;
+        }
+    }
+}
+
+static void BM_random_unit_vector(benchmark::State& state){
+    for(auto _ : state){
+        benchmark::DoNotOptimize(random_unit_vector());
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_random_unit_vector);
+
+static void BM_rejection_unit_vector(benchmark::State& state){
+    for(auto _ : state){
+        benchmark::DoNotOptimize(rejection_unit_vector());
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_rejection_unit_vector);
+
+static void BM_random_in_unit_disk(benchmark::State& state){
+    for(auto _ : state){
+        benchmark::DoNotOptimize(random_in_unit_disk());
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_random_in_unit_disk);
+
+static void BM_rejection_unit_disk(benchmark::State& state){
+    for(auto _ : state){
+        benchmark::DoNotOptimize(rejection_unit_disk());
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_rejection_unit_disk);
+
+// Lambertian's scatter direction: cosine weighted about a normal, through an Onb //
+static void BM_cosine_direction(benchmark::State& state){
+    const Vec3 n = unit_vector(Vec3(1, 2, 3));
+    for(auto _ : state){
+        benchmark::DoNotOptimize(Onb(n).to_world(cosine_direction(random_double(), random_double())));
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_cosine_direction);
+
+// What it replaced: the normal plus a rejection sampled unit vector, normalized //
+static void BM_rejection_cosine_direction(benchmark::State& state){
+    const Vec3 n = unit_vector(Vec3(1, 2, 3));
+    for(auto _ : state){
+        benchmark::DoNotOptimize(unit_vector(n + rejection_unit_vector()));
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_rejection_cosine_direction);
+
+// The batch maps over arrays of uniform samples, which the compiler vectorizes //
+template <typename T>
+struct Sample_batch{
+    static constexpr size_t size = 1024;
+    std::vector<T> u, v, x, y, z;
+
+    Sample_batch() : u(size), v(size), x(size), y(size), z(size){
+        seed_random(1, 0);
+        for(size_t k=0; k<size; k++){
+            u[k] = T(random_double());
+            v[k] = T(random_double());
+        }
+    }
+};
+
+template <typename T>
+static void BM_sphere_batch(benchmark::State& state){
+    Sample_batch<T> batch;
+    for(auto _ : state){
+        square_to_sphere(batch.u.data(), batch.v.data(), batch.x.data(), batch.y.data(), batch.z.data(), batch.size);
+        benchmark::ClobberMemory();
+    }
+    state.SetItemsProcessed(state.iterations() * batch.size);
+}
+BENCHMARK_TEMPLATE(BM_sphere_batch, float);
+BENCHMARK_TEMPLATE(BM_sphere_batch, double);
+
+template <typename T>
+static void BM_disk_batch(benchmark::State& state){
+    Sample_batch<T> batch;
+    for(auto _ : state){
+        square_to_disk(batch.u.data(), batch.v.data(), batch.x.data(), batch.y.data(), batch.size);
+        benchmark::ClobberMemory();
+    }
+    state.SetItemsProcessed(state.iterations() * batch.size);
+}
+BENCHMARK_TEMPLATE(BM_disk_batch, float);
+BENCHMARK_TEMPLATE(BM_disk_batch, double);
+
+template <typename T>
+static void BM_cosine_batch(benchmark::State& state){
+    Sample_batch<T> batch;
+    for(auto _ : state){
+        square_to_cosine_hemisphere(batch.u.data(), batch.v.data(), batch.x.data(), batch.y.data(), batch.z.data(), batch.size);
+        benchmark::ClobberMemory();
+    }
+    state.SetItemsProcessed(state.iterations() * batch.size);
+}
+BENCHMARK_TEMPLATE(BM_cosine_batch, float);
+BENCHMARK_TEMPLATE(BM_cosine_batch, double);
+
+// The distributions themselves are checked by check_sampling.cpp //
+
+// -- Lights -- //
+
+// Picking a light and a point on it among range(0) small quad lights of random brightness over the //
+// shading point; the pick is a binary search, so the cost should grow with the log of the count //
+static void BM_light_sample(benchmark::State& state){
+    Light_list lights;
+    int side = int(std::ceil(std::sqrt(double(state.range(0)))));
+    for(int k=0; k<state.range(0); k++){
+        real brightness = real(random_double(0.1, 10));
+        lights.add_quad(Point3(k % side, 10, k / side), Vec3(0.5, 0, 0), Vec3(0, 0, 0.5),
+                        Color3(brightness, brightness, brightness));
+    }
+    const Point3 from(0.5 * side, 0, 0.5 * side);
+    Light_sample sample;
+    for(auto _ : state){
+        benchmark::DoNotOptimize(lights.sample(from, random_double(), {random_double(), random_double()}, sample));
+        benchmark::DoNotOptimize(sample);
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_light_sample)->Arg(1)->Arg(64)->Arg(4096)->Arg(262144);
+
+// -- Intersection -- //
+
+// Rays from the book scene camera towards random points near the ground //
+static const std::vector<Ray>& benchmark_rays(){
+    static const std::vector<Ray> rays = []{
+        std::vector<Ray> result;
+        Pcg32 rng(7, 0);
+        for(int k=0; k<4096; k++){
+            auto target = Point3(-12 + 24*rng.next_double(), rng.next_double(), -12 + 24*rng.next_double());
+            result.push_back(Ray(Point3(13, 2, 3), target - Point3(13, 2, 3)));
+        }
+        return result;
+    }();
+    return rays;
+}
+
+// Closest hit of the benchmark rays against world, one ray per iteration //
+static void trace_rays(benchmark::State& state, const Hittable& world){
+    const auto& rays = benchmark_rays();
+    Hit_record rec;
+    size_t k = 0;
+    for(auto _ : state){
+        benchmark::DoNotOptimize(world.hit(rays[k++ & 4095], Interval(0.001, infinity), rec));
+    }
+    set_ray_rate(state, double(state.iterations()));
+}
+
+static void BM_Sphere_hit(benchmark::State& state){
+    Sphere sphere(Point3(0, 0.5, 0), 4.0, 0);
+    trace_rays(state, sphere);
+}
+BENCHMARK(BM_Sphere_hit);
+
+// 1 ground sphere and 484 small ones, as a Hittable_list and as a Sphere_set //
+struct Sphere_scene{
+    Hittable_list list;
+    Sphere_set set;
+
+    Sphere_scene(){
+        Material_id material = 0;
+        list.add(make_shared<Sphere>(Point3(0,-1000,0), 1000, material));
+        set.add(Point3(0,-1000,0), 1000, material);
+        Pcg32 rng(3, 0);
+        for(int a = -11; a < 11; a++){
+            for(int b = -11; b < 11; b++){
+                Point3 center(a + 0.9*rng.next_double(), 0.2, b + 0.9*rng.next_double());
+                list.add(make_shared<Sphere>(center, 0.2, material));
+                set.add(center, 0.2, material);
+            }
+        }
+    }
+
+    static const Sphere_scene& get(){
+        static const Sphere_scene scene;
+        return scene;
+    }
+};
+
+static void BM_Hittable_list_hit(benchmark::State& state){
+    trace_rays(state, Sphere_scene::get().list);
+}
+BENCHMARK(BM_Hittable_list_hit);
+
+static void BM_Sphere_set_flat(benchmark::State& state){
+    state.SetLabel(Sphere_set::kernel_name());
+    trace_rays(state, Sphere_scene::get().set);
+}
+BENCHMARK(BM_Sphere_set_flat);
+
+static void BM_Bvh_node_hit(benchmark::State& state){
+    Bvh_node bvh(Sphere_scene::get().list);
+    trace_rays(state, bvh);
+}
+BENCHMARK(BM_Bvh_node_hit);
+
+static void BM_Linear_bvh_hit(benchmark::State& state){
+    Linear_bvh bvh(Sphere_scene::get().list);
+    trace_rays(state, bvh);
+}
+BENCHMARK(BM_Linear_bvh_hit);
+
+static void BM_Sphere_set_built(benchmark::State& state){
+    Sphere_set set = Sphere_scene::get().set;
+    set.build();
+    state.SetLabel(Sphere_set::kernel_name());
+    trace_rays(state, set);
+}
+BENCHMARK(BM_Sphere_set_built);
+
+// UV sphere of 2 * segments^2 triangles in place of the BM_Sphere_hit sphere //
+static Triangle_mesh sphere_mesh(int segments){
+    Triangle_mesh mesh;
+    int rings = segments;
+    for(int j=0; j<=rings; j++){
+        double theta = pi * j / rings;
+        for(int i=0; i<segments; i++){
+            double phi = 2 * pi * i / segments;
+            Vec3 n(std::sin(theta)*std::cos(phi), std::cos(theta), std::sin(theta)*std::sin(phi));
+            mesh.add_vertex(Point3(0, 0.5, 0) + 4*n, n);
+        }
+    }
+    for(int j=0; j<rings; j++){
+        for(int i=0; i<segments; i++){
+            auto a = std::uint32_t(j*segments + i);
+            auto b = std::uint32_t(j*segments + (i+1) % segments);
+            mesh.add_triangle(a, a + segments, b);
+            mesh.add_triangle(b, a + segments, b + segments);
+        }
+    }
+    mesh.build();
+    return mesh;
+}
+
+static void BM_Triangle_mesh_hit(benchmark::State& state){
+    Triangle_mesh mesh = sphere_mesh(int(state.range(0)));
+    state.SetLabel(std::to_string(mesh.triangle_count()) + " triangles");
+    trace_rays(state, mesh);
+}
+BENCHMARK(BM_Triangle_mesh_hit)->Arg(16)->Arg(128)->Arg(724);
+
+// A 32x32 grid of instances of one 32k triangle mesh under a Linear_bvh, two levels of hierarchy //
+// over 33M triangles of which only the 32k unique ones are stored //
+static void BM_Instance_grid_hit(benchmark::State& state){
+    auto mesh = make_shared<Triangle_mesh>(sphere_mesh(128));
+    Hittable_list instances;
+    for(int i=0; i<32; i++){
+        for(int j=0; j<32; j++){
+            auto to_world = Transform::translate(Vec3(-12 + 0.75*i, 0.2, -12 + 0.75*j))
+                          * Transform::rotate(1, 11.25*(i+j)) * Transform::scale(Vec3(0.08, 0.08, 0.08));
+            instances.add(make_shared<Instance>(mesh, to_world));
+        }
+    }
+    Linear_bvh top(instances);
+    state.SetLabel(std::to_string(instances.objects.size() * mesh->triangle_count()) + " triangles");
+    trace_rays(state, top);
+}
+BENCHMARK(BM_Instance_grid_hit);
+
+// Moving every instance of a 64x64 grid per frame and updating the top level: arg 0 refits the //
+// Linear_bvh built for the first frame, arg 1 builds a new one as a static scene would otherwise //
+static void BM_Instance_grid_update(benchmark::State& state){
+    auto mesh = make_shared<Triangle_mesh>(sphere_mesh(16));
+    std::vector<shared_ptr<Instance>> handles;
+    Hittable_list instances;
+    for(int k=0; k<64*64; k++){
+        handles.push_back(make_shared<Instance>(mesh, Transform()));
+        instances.add(handles.back());
+    }
+    auto place = [&](int frame){
+        for(int k=0; k<int(handles.size()); k++){
+            double bob = 0.1 * std::sin(0.1 * frame + k);
+            handles[k]->set_transform(Transform::translate(Vec3(-24 + 0.75*(k%64), bob, -24 + 0.75*(k/64)))
+                                    * Transform::scale(Vec3(0.2, 0.2, 0.2)));
+        }
+    };
+    place(0);
+    Linear_bvh top(instances);
+    bool rebuild = state.range(0) == 1;
+    int frame = 1;
+    for(auto _ : state){
+        place(frame++);
+        if(rebuild){
+            Linear_bvh fresh(instances);
+            benchmark::DoNotOptimize(fresh.bounding_box());
+        }else{
+            top.refit();
+            benchmark::DoNotOptimize(top.bounding_box());
+        }
+    }
+    state.SetLabel(rebuild ? "rebuild" : "refit");
+}
+BENCHMARK(BM_Instance_grid_update)->Arg(0)->Arg(1)->Unit(benchmark::kMicrosecond);
+
+// Pinhole camera rays through the centre block of pixels of the rayTracing.cpp view, row by row //
+static std::vector<Ray> primary_rays(int width, int height, int block){
+    auto lookfrom = Point3(20,1,3);
+    auto w = unit_vector(lookfrom - Point3(0,0,0));
+    auto u = unit_vector(cross(Vec3(0,1,0), w));
+    auto v = cross(w, u);
+    auto viewport_height = 2 * std::tan(degrees_to_radians(7)/2) * 15.0;
+    auto viewport_width = viewport_height * double(width)/height;
+    auto delta_u = viewport_width * u / width;
+    auto delta_v = viewport_height * -v / height;
+    auto pixel00 = lookfrom - 15.0*w - (width/2.0)*delta_u - (height/2.0)*delta_v;
+
+    std::vector<Ray> rays;
+    for(int j=(height-block)/2; j<(height+block)/2; j++){
+        for(int i=(width-block)/2; i<(width+block)/2; i++){
+            rays.push_back(Ray(lookfrom, pixel00 + (i+0.5)*delta_u + (j+0.5)*delta_v - lookfrom));
+        }
+    }
+    return rays;
+}
+
+// The rayTracing.cpp scene built once with a fixed seed, as a Scene behind a Linear_bvh //
+// or as a Static_scene //
+template <typename Scene_type>
+static const Scene_type& book_scene();
+
+template <>
+const Scene& book_scene<Scene>(){
+    static const Scene scene = []{
+        seed_random(0, 0);
+        Scene result = random_spheres_scene();
+        result.world = Hittable_list(make_shared<Linear_bvh>(result.world));
+        return result;
+    }();
+    return scene;
+}
+
+template <>
+const Static_scene& book_scene<Static_scene>(){
+    static const Static_scene scene = []{
+        seed_random(0, 0);
+        auto result = random_spheres_scene<Static_scene>();
+        result.build();
+        return result;
+    }();
+    return scene;
+}
+
+template <typename Scene_type>
+static void BM_primary_single(benchmark::State& state){
+    const auto& scene = book_scene<Scene_type>();
+    auto rays = primary_rays(1920, 1080, 256);
+    Hit_record rec;
+    size_t k = 0;
+    for(auto _ : state){
+        benchmark::DoNotOptimize(scene.hit(rays[k], Interval(0.001, infinity), rec));
+        k = k+1 == rays.size() ? 0 : k+1;
+    }
+    set_ray_rate(state, double(state.iterations()));
+}
+BENCHMARK_TEMPLATE(BM_primary_single, Scene);
+BENCHMARK_TEMPLATE(BM_primary_single, Static_scene);
+
+template <typename Scene_type>
+static void BM_primary_packet(benchmark::State& state){
+    const auto& scene = book_scene<Scene_type>();
+    auto rays = primary_rays(1920, 1080, 256);
+    size_t k = 0;
+    for(auto _ : state){
+        Ray_packet packet;
+        packet.count = Ray_packet::size;
+        for(int lane=0; lane<Ray_packet::size; lane++){
+            packet.set(lane, rays[k + lane]);
+        }
+        Packet_hit hits(packet, Interval(0.001, infinity));
+        scene.hit_packet(packet, hits);
+        benchmark::DoNotOptimize(hits.hit);
+        k = k + 2*Ray_packet::size > rays.size() ? 0 : k + Ray_packet::size;
+    }
+    set_ray_rate(state, double(state.iterations()) * Ray_packet::size);
+}
+BENCHMARK_TEMPLATE(BM_primary_packet, Scene);
+BENCHMARK_TEMPLATE(BM_primary_packet, Static_scene);
+
+// -- Materials -- //
+
+// A ray hitting the top of a unit sphere at 45 degrees //
+template <typename Mat>
+static void BM_scatter(benchmark::State& state, Mat material){
+    Hit_record rec;
+    rec.P = Point3(0, 1, 0);
+    rec.t = 1;
+    Ray ray_in(Point3(-1, 2, 0), Vec3(1, -1, 0));
+    rec.set_face_normal(ray_in, Vec3(0, 1, 0));
+    Color3 attenuation;
+    Ray scattered;
+    for(auto _ : state){
+        benchmark::DoNotOptimize(material.scatter(ray_in, rec, attenuation, scattered));
+        benchmark::DoNotOptimize(scattered);
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK_CAPTURE(BM_scatter, Lambertian, Lambertian(Color3(0.5, 0.5, 0.5)));
+BENCHMARK_CAPTURE(BM_scatter, Metal, Metal(Color3(0.7, 0.6, 0.5), 0.3));
+BENCHMARK_CAPTURE(BM_scatter, Dielectric, Dielectric(1.5));
+
+// Scatter through the scene, cycling over the book scene's materials in a fixed random order so //
+// the dispatch sees the same mix of types as a render: a virtual call into the Material_table //
+// for Scene, a std::visit for Static_scene //
+template <typename Scene_type>
+static void BM_scatter_dispatch(benchmark::State& state){
+    const auto& scene = book_scene<Scene_type>();
+    std::vector<Material_id> ids(4096);
+    Pcg32 rng(5, 0);
+    for(auto& id : ids){
+        id = Material_id(rng.next_u32() % scene.material_count());
+    }
+    Hit_record rec;
+    rec.P = Point3(0, 1, 0);
+    rec.t = 1;
+    Ray ray_in(Point3(-1, 2, 0), Vec3(1, -1, 0));
+    rec.set_face_normal(ray_in, Vec3(0, 1, 0));
+    Color3 attenuation;
+    Ray scattered;
+    size_t k = 0;
+    for(auto _ : state){
+        rec.mat = ids[k++ & 4095];
+        benchmark::DoNotOptimize(scene.scatter(ray_in, rec, attenuation, scattered));
+        benchmark::DoNotOptimize(scattered);
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK_TEMPLATE(BM_scatter_dispatch, Scene);
+BENCHMARK_TEMPLATE(BM_scatter_dispatch, Static_scene);
+
+// Recording an accepted hit the way Sphere::hit and then Hittable_list::hit do. With an owning //
+// material pointer in the record every hit is an atomic increment and decrement on a count that //
+// all threads hitting the same material share, with an index it is a plain store. //
+static void BM_record_shared_ptr(benchmark::State& state){
+    static const shared_ptr<Material> material = make_shared<Lambertian>(Color3(0.5, 0.5, 0.5));
+    // Hit_record as it was before the material table //
+    struct Record{
+        Point3 P;
+        Vec3 N;
+        double t;
+        bool front_face;
+        shared_ptr<Material> mat;
+    };
+    Record rec{}, temp_rec{};
+    for(auto _ : state){
+        temp_rec.t = 1.0;
+        temp_rec.mat = material;
+        rec = temp_rec;
+        benchmark::DoNotOptimize(rec);
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_record_shared_ptr)->ThreadRange(1, 8);
+
+static void BM_record_material_id(benchmark::State& state){
+    static const Material_id material = 0;
+    Hit_record rec, temp_rec;
+    for(auto _ : state){
+        temp_rec.t = 1.0;
+        temp_rec.mat = material;
+        rec = temp_rec;
+        benchmark::DoNotOptimize(rec);
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_record_material_id)->ThreadRange(1, 8);
+
+// -- Full frames -- //
+
+// Passes every query on to the wrapped scene and counts the rays, primary and secondary //
+template <typename Scene_type>
+class Counting_scene{
+    private:
+    const Scene_type& scene;
+
+    public:
+    mutable std::atomic<long long> rays{0};
+
+    Counting_scene(const Scene_type& scene) : scene(scene) {}
+
+    bool hit(const Ray& r, Interval ray_t, Hit_record& rec) const{
+        rays.fetch_add(1, std::memory_order_relaxed);
+        return scene.hit(r, ray_t, rec);
+    }
+
+    void hit_packet(const Ray_packet& packet, Packet_hit& hits) const{
+        rays.fetch_add(packet.count, std::memory_order_relaxed);
+        scene.hit_packet(packet, hits);
+    }
+
+    bool scatter(const Ray& ray_in, const Hit_record& rec, Color3& attenuation, Ray& scattered) const{
+        return scene.scatter(ray_in, rec, attenuation, scattered);
+    }
+
+    Color3 base_color(const Hit_record& rec) const{
+        return scene.base_color(rec);
+    }
+
+    Color3 emitted(const Hit_record& rec) const{
+        return scene.emitted(rec);
+    }
+
+    bool evaluate(const Ray& ray_in, const Hit_record& rec, const Vec3& direction, Color3& f_cos, double& pdf) const{
+        return scene.evaluate(ray_in, rec, direction, f_cos, pdf);
+    }
+
+    const Light_list& lights() const{
+        return scene.lights();
+    }
+
+    std::type_index material_type(Material_id mat) const{
+        return scene.material_type(mat);
+    }
+
+    size_t material_count() const{
+        return scene.material_count();
+    }
+};
+
+// The rayTracing.cpp scene and camera at a fixed seed, 4 samples per pixel. //
+// range(0) is the image width, range(1) the number of render threads. //
+template <typename Scene_type>
+static void BM_render(benchmark::State& state){
+    Counting_scene<Scene_type> scene(book_scene<Scene_type>());
+    Camera cam;
+    cam.aspect_ratio = 16.0 / 9.0;
+    cam.image_width = int(state.range(0));
+    cam.samples_per_pixel = 4;
+    cam.vfov = 7;
+    cam.lookfrom = Point3(20,1,3);
+    cam.lookat = Point3(0,0,0);
+    cam.vup = Vec3(0,1,0);
+    cam.defocus_angle = 0.6;
+    cam.focus_dist = 15.0;
+    cam.packet_tracing = true;
+    cam.num_threads = int(state.range(1));
+    cam.quiet = true;
+    for(auto _ : state){
+        cam.render_image(scene);
+    }
+    set_ray_rate(state, double(scene.rays.load()));
+}
+BENCHMARK_TEMPLATE(BM_render, Scene)->Args({160, 1})->Args({320, 1})->Args({640, 1})->Args({640, 4})
+    ->Unit(benchmark::kMillisecond)->UseRealTime();
+BENCHMARK_TEMPLATE(BM_render, Static_scene)->Args({160, 1})->Args({320, 1})->Args({640, 1})->Args({640, 4})
+    ->Unit(benchmark::kMillisecond)->UseRealTime();
+
+BENCHMARK_MAIN();
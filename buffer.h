@@ -0,0 +1,60 @@
+#ifndef BUFFER_H
+#define BUFFER_H
+
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+// Array that either owns its elements or refers to elements kept alive by someone else, such as a //
+// memory mapped scene file. Reading works the same either way, changing a referenced array copies it first. //
+template <typename T>
+class Buffer{
+    private:
+    std::vector<T> owned;
+    const T* external = nullptr;
+    size_t external_size = 0;
+    std::shared_ptr<const void> keep_alive; //owner of the external elements//
+
+    public:
+    Buffer() {}
+
+    // Refer to count elements at data, which stay valid while owner is alive //
+    static Buffer view(const T* data, size_t count, std::shared_ptr<const void> owner){
+        Buffer buffer;
+        if(count > 0){
+            buffer.external = data;
+            buffer.external_size = count;
+            buffer.keep_alive = std::move(owner);
+        }
+        return buffer;
+    }
+
+    size_t size() const{
+        return external ? external_size : owned.size();
+    }
+
+    bool empty() const{
+        return size() == 0;
+    }
+
+    const T* data() const{
+        return external ? external : owned.data();
+    }
+
+    const T& operator[](size_t k) const{
+        return data()[k];
+    }
+
+    // The elements as an owned vector that can be changed //
+    std::vector<T>& vector(){
+        if(external){
+            owned.assign(external, external + external_size);
+            external = nullptr;
+            external_size = 0;
+            keep_alive.reset();
+        }
+        return owned;
+    }
+};
+
+#endif
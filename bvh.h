@@ -0,0 +1,648 @@
+#ifndef BVH_H
+#define BVH_H
+
+#include "aabb.h"
+#include "buffer.h"
+#include "hittable.h"
+#include "hittable_list.h"
+#include "interval.h"
+#include "rtweekend.h"
+#include "stats.h"
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <utility>
+#include <vector>
+
+// Bounding box, centroid and index of one primitive, the only things a BVH builder needs to know //
+struct Bvh_primitive{
+    Aabb box;
+    Point3 centroid;
+    int index;
+};
+
+// Binned surface area heuristic (SAH) used by every hierarchy in the renderer. //
+// A split costs one box test plus the expected number of primitive tests on each side, //
+// weighted by the probability (surface area ratio) that a ray entering the parent enters that child. //
+class Sah_builder{
+    public:
+    static constexpr int bin_count = 16;
+    static constexpr double traversal_cost = 1.0;
+    static constexpr double intersection_cost = 1.0;
+
+    static std::vector<Bvh_primitive> primitives_of(const std::vector<Aabb>& boxes){
+        std::vector<Bvh_primitive> prims(boxes.size());
+        for(size_t k=0; k<boxes.size(); k++){
+            prims[k] = Bvh_primitive{boxes[k], boxes[k].centroid(), int(k)};
+        }
+        return prims;
+    }
+
+    // Reorder prims[begin, end) around the cheapest split and return the index of the first //
+    // primitive of the right half, or `end` when keeping them together as one leaf is cheaper. //
+    // The axis of the chosen plane is written to split_axis when it is given. //
+    static int split(std::vector<Bvh_primitive>& prims, int begin, int end, int max_leaf_size, int* split_axis = nullptr){
+        int count = end - begin;
+        if(count <= 1){
+            return end;
+        }
+
+        Aabb bounds, centroid_bounds;
+        for(int k=begin; k<end; k++){
+            bounds = Aabb(bounds, prims[k].box);
+            centroid_bounds = Aabb(centroid_bounds, Aabb(prims[k].centroid, prims[k].centroid));
+        }
+
+        double best_cost = infinity;
+        int best_axis = -1;
+        int best_bin = 0;
+        for(int axis=0; axis<3; axis++){
+            const Interval& extent = centroid_bounds.axis_interval(axis);
+            if(extent.size() <= 0){
+                continue;
+            }
+
+            // Drop every primitive into a bin by its centroid //
+            Aabb bin_boxes[bin_count];
+            int bin_counts[bin_count] = {};
+            for(int k=begin; k<end; k++){
+                int b = bin_of(prims[k].centroid[axis], extent);
+                bin_counts[b]++;
+                bin_boxes[b] = Aabb(bin_boxes[b], prims[k].box);
+            }
+
+            // Sweep from the right to get the area and count of every right hand side //
+            double right_area[bin_count];
+            int right_count[bin_count];
+            Aabb right_box;
+            int right_total = 0;
+            for(int b=bin_count-1; b>0; b--){
+                right_box = Aabb(right_box, bin_boxes[b]);
+                right_total += bin_counts[b];
+                right_area[b] = right_box.surface_area();
+                right_count[b] = right_total;
+            }
+
+            // Then sweep from the left, splitting between bin b-1 and bin b //
+            Aabb left_box;
+            int left_total = 0;
+            for(int b=1; b<bin_count; b++){
+                left_box = Aabb(left_box, bin_boxes[b-1]);
+                left_total += bin_counts[b-1];
+                if(left_total == 0 || right_count[b] == 0){
+                    continue;
+                }
+                double cost = left_box.surface_area()*left_total + right_area[b]*right_count[b];
+                if(cost < best_cost){
+                    best_cost = cost;
+                    best_axis = axis;
+                    best_bin = b;
+                }
+            }
+        }
+
+        double parent_area = bounds.surface_area();
+        double leaf_cost = intersection_cost * count;
+        if(best_axis < 0){
+            // Every centroid is in the same place, no plane can separate them //
+            if(count <= max_leaf_size){
+                return end;
+            }
+            int mid = begin + count/2;
+            if(split_axis) *split_axis = bounds.longest_axis();
+            std::nth_element(prims.begin()+begin, prims.begin()+mid, prims.begin()+end,
+                [](const Bvh_primitive& a, const Bvh_primitive& b){ return a.index < b.index; });
+            return mid;
+        }
+
+        double split_cost = traversal_cost + intersection_cost * best_cost / parent_area;
+        if(count <= max_leaf_size && leaf_cost <= split_cost){
+            return end;
+        }
+
+        if(split_axis) *split_axis = best_axis;
+        const Interval extent = centroid_bounds.axis_interval(best_axis);
+        auto middle = std::partition(prims.begin()+begin, prims.begin()+end,
+            [&](const Bvh_primitive& p){ return bin_of(p.centroid[best_axis], extent) < best_bin; });
+        return int(middle - prims.begin());
+    }
+
+    // Split prims[begin, end) into halves at the median centroid along the axis the centroids //
+    // spread widest, or return `end` when they fit one leaf. Every level halves the count, so a //
+    // subtree built this way is at most 32 levels deep whatever the primitives look like. //
+    static int median_split(std::vector<Bvh_primitive>& prims, int begin, int end, int max_leaf_size, int* split_axis = nullptr){
+        int count = end - begin;
+        if(count <= std::max(max_leaf_size, 1)){
+            return end;
+        }
+        Aabb centroid_bounds;
+        for(int k=begin; k<end; k++){
+            centroid_bounds = Aabb(centroid_bounds, Aabb(prims[k].centroid, prims[k].centroid));
+        }
+        int axis = centroid_bounds.longest_axis();
+        if(split_axis) *split_axis = axis;
+        int mid = begin + count/2;
+        std::nth_element(prims.begin()+begin, prims.begin()+mid, prims.begin()+end,
+            [axis](const Bvh_primitive& a, const Bvh_primitive& b){
+                return a.centroid[axis] < b.centroid[axis] || (a.centroid[axis] == b.centroid[axis] && a.index < b.index);
+            });
+        return mid;
+    }
+
+    private:
+    static int bin_of(double centroid, const Interval& extent){
+        int b = int(bin_count * (centroid - extent.min) / extent.size());
+        return std::min(std::max(b, 0), bin_count-1);
+    }
+};
+
+// Pointer based bounding volume hierarchy over any set of hittables //
+class Bvh_node : public Hittable{
+    private:
+    shared_ptr<Hittable> left;
+    shared_ptr<Hittable> right;
+    Aabb bbox;
+
+    Bvh_node(const std::vector<shared_ptr<Hittable>>& objects, std::vector<Bvh_primitive>& prims,
+             int begin, int end, int max_leaf_size){
+        for(int k=begin; k<end; k++){
+            bbox = Aabb(bbox, prims[k].box);
+        }
+
+        int mid = Sah_builder::split(prims, begin, end, max_leaf_size);
+        if(mid == end){
+            // Leaf: both children point at the same object or list of objects //
+            if(end - begin == 1){
+                left = objects[prims[begin].index];
+            }else{
+                auto leaf = make_shared<Hittable_list>();
+                for(int k=begin; k<end; k++){
+                    leaf->add(objects[prims[k].index]);
+                }
+                left = leaf;
+            }
+            right = left;
+            return;
+        }
+
+        left = make_child(objects, prims, begin, mid, max_leaf_size);
+        right = make_child(objects, prims, mid, end, max_leaf_size);
+    }
+
+    static shared_ptr<Hittable> make_child(const std::vector<shared_ptr<Hittable>>& objects, std::vector<Bvh_primitive>& prims,
+                                           int begin, int end, int max_leaf_size){
+        if(end - begin == 1){
+            return objects[prims[begin].index];
+        }
+        return shared_ptr<Bvh_node>(new Bvh_node(objects, prims, begin, end, max_leaf_size));
+    }
+
+    public:
+    Bvh_node(const Hittable_list& list, int max_leaf_size = 4){
+        std::vector<Aabb> boxes;
+        boxes.reserve(list.objects.size());
+        for(const auto& object : list.objects){
+            boxes.push_back(object->bounding_box());
+        }
+        auto prims = Sah_builder::primitives_of(boxes);
+        if(!prims.empty()){
+            *this = Bvh_node(list.objects, prims, 0, int(prims.size()), max_leaf_size);
+        }
+    }
+
+    bool hit(const Ray& r, Interval ray_t, Hit_record& rec) const override{
+        RT_STAT_ADD(Stat::bvh_nodes, 1);
+        if(!left || !bbox.hit(r, ray_t)){
+            return false;
+        }
+
+        bool hit_left = left->hit(r, ray_t, rec);
+        if(right == left){
+            return hit_left;
+        }
+        bool hit_right = right->hit(r, Interval(ray_t.min, hit_left ? rec.t : ray_t.max), rec);
+
+        return hit_left || hit_right;
+    }
+
+    Aabb bounding_box() const override{
+        return bbox;
+    }
+
+    bool uses_marked_material(const std::vector<char>& marked) const override{
+        return left && (left->uses_marked_material(marked) || right->uses_marked_material(marked));
+    }
+
+    void refit() override{
+        if(!left){
+            return;
+        }
+        left->refit();
+        if(right != left){
+            right->refit();
+        }
+        bbox = Aabb(left->bounding_box(), right->bounding_box());
+    }
+};
+
+// Compact node of a flattened hierarchy, two nodes per 64 byte cache line. //
+// Interior nodes keep their first child right after themselves and store the second child's index; //
+// leaves store the range of their primitives in the hierarchy's primitive order. //
+struct alignas(32) Bvh_flat_node{
+    float bounds_min[3];
+    float bounds_max[3];
+    std::uint32_t offset; //second child for interior nodes, first primitive for leaves//
+    std::uint16_t count; //number of primitives, 0 for interior nodes//
+    std::uint8_t axis; //split axis, used to visit the nearer child first//
+    std::uint8_t pad;
+};
+static_assert(sizeof(Bvh_flat_node) == 32, "Bvh_flat_node must stay 32 bytes");
+
+// Ray prepared once per traversal for the float slab test //
+struct Bvh_ray{
+    float origin[3];
+    float inv_dir[3];
+    int dir_is_neg[3];
+
+    Bvh_ray(const Ray& r){
+        for(int axis=0; axis<3; axis++){
+            origin[axis] = float(r.origin()[axis]);
+            inv_dir[axis] = float(1.0 / r.direction()[axis]);
+            dir_is_neg[axis] = inv_dir[axis] < 0;
+        }
+    }
+};
+
+// Packet prepared once per traversal. Lanes past the packet's count hold the packet's zeroed //
+// rays and are never accepted, Packet_hit gives them an empty interval. //
+struct Bvh_packet{
+    float ox[Ray_packet::size], oy[Ray_packet::size], oz[Ray_packet::size];
+    float inv_dx[Ray_packet::size], inv_dy[Ray_packet::size], inv_dz[Ray_packet::size];
+    int dir_is_neg[3]; //direction signs of the first ray, which decide the visiting order//
+
+    Bvh_packet(const Ray_packet& rays){
+        for(int lane=0; lane<Ray_packet::size; lane++){
+            ox[lane] = float(rays.ox[lane]);
+            oy[lane] = float(rays.oy[lane]);
+            oz[lane] = float(rays.oz[lane]);
+            inv_dx[lane] = float(1.0 / rays.dx[lane]);
+            inv_dy[lane] = float(1.0 / rays.dy[lane]);
+            inv_dz[lane] = float(1.0 / rays.dz[lane]);
+        }
+        dir_is_neg[0] = inv_dx[0] < 0;
+        dir_is_neg[1] = inv_dy[0] < 0;
+        dir_is_neg[2] = inv_dz[0] < 0;
+    }
+};
+
+// Flattened hierarchy over primitive bounding boxes. It does not know what the primitives are: //
+// the owner builds it from boxes, stores its primitives in order(), and intersects them in traverse(). //
+class Flat_bvh{
+    private:
+    Buffer<Bvh_flat_node> nodes;
+    std::vector<std::uint32_t> primitive_order;
+
+    static void set_bounds(Bvh_flat_node& node, const Aabb& box){
+        // Round outwards so the float box always contains the double one //
+        for(int axis=0; axis<3; axis++){
+            const Interval& ax = box.axis_interval(axis);
+            float lo = float(ax.min);
+            float hi = float(ax.max);
+            node.bounds_min[axis] = std::nextafter(lo, -std::numeric_limits<float>::infinity());
+            node.bounds_max[axis] = std::nextafter(hi, std::numeric_limits<float>::infinity());
+        }
+    }
+
+    // depth counts the nodes above this one. Past max_depth / 2 the tree is split at medians, so no //
+    // leaf ends up deeper than max_depth and the traversal stacks never overflow. //
+    std::uint32_t build(std::vector<Bvh_primitive>& prims, int begin, int end, int max_leaf_size, int depth){
+        auto& out = nodes.vector();
+        auto index = std::uint32_t(out.size());
+        out.emplace_back();
+
+        Aabb bounds;
+        for(int k=begin; k<end; k++){
+            bounds = Aabb(bounds, prims[k].box);
+        }
+        set_bounds(out[index], bounds);
+
+        int axis = 0;
+        int mid = depth < max_depth / 2 ? Sah_builder::split(prims, begin, end, max_leaf_size, &axis)
+                                        : Sah_builder::median_split(prims, begin, end, max_leaf_size, &axis);
+        if(mid == end){
+            out[index].offset = std::uint32_t(primitive_order.size());
+            out[index].count = std::uint16_t(end - begin);
+            for(int k=begin; k<end; k++){
+                primitive_order.push_back(std::uint32_t(prims[k].index));
+            }
+            return index;
+        }
+
+        build(prims, begin, mid, max_leaf_size, depth + 1);
+        auto second = build(prims, mid, end, max_leaf_size, depth + 1);
+        out[index].offset = second;
+        out[index].count = 0;
+        out[index].axis = std::uint8_t(axis);
+        return index;
+    }
+
+    static bool hit_node(const Bvh_flat_node& node, const Bvh_ray& r, float t_min, float t_max){
+        // Slab test in the style of PBRT: NaNs from 0 * inf fall out of the comparisons //
+        float near_t = t_min;
+        float far_t = t_max;
+        for(int axis=0; axis<3; axis++){
+            float lo = r.dir_is_neg[axis] ? node.bounds_max[axis] : node.bounds_min[axis];
+            float hi = r.dir_is_neg[axis] ? node.bounds_min[axis] : node.bounds_max[axis];
+            float t0 = (lo - r.origin[axis]) * r.inv_dir[axis];
+            float t1 = (hi - r.origin[axis]) * r.inv_dir[axis];
+            // Widen the exit distance by the float rounding error of the three operations above //
+            t1 *= 1 + 2 * 3.58e-7f;
+            if(t0 > near_t) near_t = t0;
+            if(t1 < far_t) far_t = t1;
+            if(near_t > far_t){
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // Slab test of every lane at once, true when any lane enters the box before its closest hit //
+    static bool hit_node(const Bvh_flat_node& node, const Bvh_packet& p, float t_min, const real* closest){
+        bool any = false;
+        for(int lane=0; lane<Ray_packet::size; lane++){
+            float tx0 = (node.bounds_min[0] - p.ox[lane]) * p.inv_dx[lane];
+            float tx1 = (node.bounds_max[0] - p.ox[lane]) * p.inv_dx[lane];
+            float ty0 = (node.bounds_min[1] - p.oy[lane]) * p.inv_dy[lane];
+            float ty1 = (node.bounds_max[1] - p.oy[lane]) * p.inv_dy[lane];
+            float tz0 = (node.bounds_min[2] - p.oz[lane]) * p.inv_dz[lane];
+            float tz1 = (node.bounds_max[2] - p.oz[lane]) * p.inv_dz[lane];
+            float near_t = std::max(std::max(std::min(tx0, tx1), std::min(ty0, ty1)), std::max(std::min(tz0, tz1), t_min));
+            float far_t = std::min(std::min(std::max(tx0, tx1), std::max(ty0, ty1)), std::max(tz0, tz1)) * (1 + 2 * 3.58e-7f);
+            any |= near_t <= std::min(far_t, float(closest[lane]));
+        }
+        return any;
+    }
+
+    public:
+    static constexpr int max_depth = 64; //deepest leaf, and the size of the traversal stacks//
+
+    Flat_bvh() {}
+    Flat_bvh(const std::vector<Aabb>& boxes, int max_leaf_size = 4){
+        RT_STAT_TIMER("bvh_build");
+        auto prims = Sah_builder::primitives_of(boxes);
+        nodes.vector().reserve(2 * prims.size());
+        primitive_order.reserve(prims.size());
+        if(!prims.empty()){
+            build(prims, 0, int(prims.size()), std::min(max_leaf_size, 65535), 0);
+        }
+    }
+
+    // Recompute the node bounds for primitives that moved, keeping the tree. boxes holds the new box //
+    // of every primitive in leaf order. Children come after their parent, so one backwards pass //
+    // sees both children of a node before the node itself. //
+    void refit(const std::vector<Aabb>& boxes){
+        auto& out = nodes.vector();
+        for(size_t k=out.size(); k-- > 0; ){
+            Bvh_flat_node& node = out[k];
+            if(node.count > 0){
+                Aabb bounds;
+                for(std::uint32_t p=node.offset; p<node.offset + node.count; p++){
+                    bounds = Aabb(bounds, boxes[p]);
+                }
+                set_bounds(node, bounds);
+                continue;
+            }
+            const Bvh_flat_node& first = out[k+1];
+            const Bvh_flat_node& second = out[node.offset];
+            for(int axis=0; axis<3; axis++){
+                node.bounds_min[axis] = std::min(first.bounds_min[axis], second.bounds_min[axis]);
+                node.bounds_max[axis] = std::max(first.bounds_max[axis], second.bounds_max[axis]);
+            }
+        }
+    }
+
+    // Primitive indices in leaf order, owners should lay their primitives out in this order //
+    const std::vector<std::uint32_t>& order() const{
+        return primitive_order;
+    }
+
+    // Hierarchy whose nodes are stored elsewhere, e.g. in a mapped scene file, over primitives //
+    // already laid out in leaf order. order() is empty. //
+    static Flat_bvh view(const Bvh_flat_node* nodes, size_t count, std::shared_ptr<const void> owner){
+        Flat_bvh bvh;
+        bvh.nodes = Buffer<Bvh_flat_node>::view(nodes, count, std::move(owner));
+        return bvh;
+    }
+
+    // Whether nodes are a hierarchy the traversals can walk without leaving the arrays: children //
+    // inside nodes and after their parent, every node reached once, split axes in range, and leaves //
+    // within primitive_count primitives and no deeper than max_depth. Checks nodes that come from //
+    // outside, e.g. a scene file, before view() uses them. //
+    static bool valid(const Bvh_flat_node* nodes, size_t count, size_t primitive_count){
+        if(count == 0){
+            return true;
+        }
+        std::vector<bool> reached(count, false);
+        std::vector<std::pair<size_t, int>> pending = {{0, 0}};
+        while(!pending.empty()){
+            auto [index, depth] = pending.back();
+            pending.pop_back();
+            if(index >= count || reached[index]){
+                return false;
+            }
+            reached[index] = true;
+            const Bvh_flat_node& node = nodes[index];
+            if(node.count > 0){
+                if(depth > max_depth || std::uint64_t(node.offset) + node.count > primitive_count){
+                    return false;
+                }
+                continue;
+            }
+            if(depth >= max_depth || node.axis > 2 || node.offset <= index){
+                return false;
+            }
+            pending.push_back({index + 1, depth + 1});
+            pending.push_back({node.offset, depth + 1});
+        }
+        return true;
+    }
+
+    const Buffer<Bvh_flat_node>& node_array() const{
+        return nodes;
+    }
+
+    // Visit the leaves along r front to back by the sign of the ray direction. //
+    // hit_leaf(first, count, closest) tests primitives [first, first+count) of order() against //
+    // [ray_t.min, closest], lowers closest on a hit and returns true; nodes beyond closest are then skipped. //
+    template <typename Fn>
+    bool traverse_leaves(const Ray& r, Interval ray_t, Fn&& hit_leaf) const{
+        if(nodes.empty()){
+            return false;
+        }
+
+        Bvh_ray bray(r);
+        real closest = ray_t.max;
+        bool hit_anything = false;
+
+        std::uint32_t stack[max_depth];
+        int stack_size = 0;
+        std::uint32_t current = 0;
+        while(true){
+            const Bvh_flat_node& node = nodes[current];
+            RT_STAT_ADD(Stat::bvh_nodes, 1);
+            if(hit_node(node, bray, float(ray_t.min), float(closest))){
+                if(node.count > 0){
+                    RT_STAT_ADD(Stat::primitive_tests, node.count);
+                    if(hit_leaf(node.offset, std::uint32_t(node.count), closest)){
+                        hit_anything = true;
+                    }
+                }else{
+                    // Visit the child on the near side of the split first, defer the other. One //
+                    // entry per level above, which the depth limit keeps within the stack. //
+                    assert(stack_size < max_depth);
+                    if(bray.dir_is_neg[node.axis]){
+                        stack[stack_size++] = current + 1;
+                        current = node.offset;
+                    }else{
+                        stack[stack_size++] = node.offset;
+                        current = current + 1;
+                    }
+                    continue;
+                }
+            }
+            if(stack_size == 0){
+                break;
+            }
+            current = stack[--stack_size];
+        }
+        return hit_anything;
+    }
+
+    // Packet version of traverse_leaves: a node is entered when any lane of the packet hits it, //
+    // children are ordered by the first ray's direction. hit_leaf(first, count) must test the //
+    // primitives against every lane and lower hits.closest, which later node tests read. //
+    template <typename Fn>
+    void traverse_packet_leaves(const Ray_packet& rays, const Packet_hit& hits, Fn&& hit_leaf) const{
+        if(nodes.empty()){
+            return;
+        }
+
+        Bvh_packet packet(rays);
+        std::uint32_t stack[max_depth];
+        int stack_size = 0;
+        std::uint32_t current = 0;
+        while(true){
+            const Bvh_flat_node& node = nodes[current];
+            RT_STAT_ADD(Stat::bvh_nodes, rays.count);
+            if(hit_node(node, packet, float(hits.t_min), hits.closest)){
+                if(node.count > 0){
+                    RT_STAT_ADD(Stat::primitive_tests, node.count * rays.count);
+                    hit_leaf(node.offset, std::uint32_t(node.count));
+                }else{
+                    assert(stack_size < max_depth);
+                    if(packet.dir_is_neg[node.axis]){
+                        stack[stack_size++] = current + 1;
+                        current = node.offset;
+                    }else{
+                        stack[stack_size++] = node.offset;
+                        current = current + 1;
+                    }
+                    continue;
+                }
+            }
+            if(stack_size == 0){
+                break;
+            }
+            current = stack[--stack_size];
+        }
+    }
+
+    // Same as traverse_leaves but calls hit_primitive(k, closest) for each primitive of a leaf //
+    template <typename Fn>
+    bool traverse(const Ray& r, Interval ray_t, Fn&& hit_primitive) const{
+        return traverse_leaves(r, ray_t, [&](std::uint32_t first, std::uint32_t count, real& closest){
+            bool hit_anything = false;
+            for(std::uint32_t k=first; k<first + count; k++){
+                if(hit_primitive(k, closest)){
+                    hit_anything = true;
+                }
+            }
+            return hit_anything;
+        });
+    }
+};
+
+// Hierarchy over hittables flattened into contiguous arrays, the objects are laid out in leaf order //
+class Linear_bvh : public Hittable{
+    private:
+    Flat_bvh bvh;
+    std::vector<const Hittable*> ordered; //raw pointers in leaf order, owned by objects//
+    std::vector<shared_ptr<Hittable>> objects;
+    Aabb bbox;
+
+    public:
+    Linear_bvh(const Hittable_list& list, int max_leaf_size = 4) : objects(list.objects) {
+        std::vector<Aabb> boxes;
+        boxes.reserve(objects.size());
+        for(const auto& object : objects){
+            boxes.push_back(object->bounding_box());
+            bbox = Aabb(bbox, boxes.back());
+        }
+        bvh = Flat_bvh(boxes, max_leaf_size);
+
+        ordered.reserve(objects.size());
+        for(auto index : bvh.order()){
+            ordered.push_back(objects[index].get());
+        }
+    }
+
+    bool hit(const Ray& r, Interval ray_t, Hit_record& rec) const override{
+        return bvh.traverse(r, ray_t, [&](std::uint32_t k, real& closest){
+            if(ordered[k]->hit(r, Interval(ray_t.min, closest), rec)){
+                closest = rec.t;
+                return true;
+            }
+            return false;
+        });
+    }
+
+    void hit_packet(const Ray_packet& rays, Packet_hit& hits) const override{
+        bvh.traverse_packet_leaves(rays, hits, [&](std::uint32_t first, std::uint32_t count){
+            for(std::uint32_t k=first; k<first + count; k++){
+                ordered[k]->hit_packet(rays, hits);
+            }
+        });
+    }
+
+    Aabb bounding_box() const override{
+        return bbox;
+    }
+
+    bool uses_marked_material(const std::vector<char>& marked) const override{
+        for(const auto& object : objects){
+            if(object->uses_marked_material(marked)){
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void refit() override{
+        std::vector<Aabb> boxes;
+        boxes.reserve(ordered.size());
+        bbox = Aabb();
+        for(auto& object : objects){
+            object->refit();
+        }
+        for(const auto* object : ordered){
+            boxes.push_back(object->bounding_box());
+            bbox = Aabb(bbox, boxes.back());
+        }
+        bvh.refit(boxes);
+    }
+};
+
+#endif
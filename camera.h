@@ -2,13 +2,28 @@
 #define CAMERA_H
 
 #include "hittable.h"
+#include "scene.h"
+#include "stats.h"
 #include "ray.h"
+#include "ray_packet.h"
 #include "rtweekend.h"
 #include "vec3.h"
 #include "color.h"
+#include "denoise.h"
+#include "framebuffer.h"
+#include "image_io.h"
+#include "partial_image.h"
+#include "sampler.h"
+#include "thread_pool.h"
+#include "wavefront.h"
+#include <algorithm>
+#include <atomic>
 #include <chrono>
 #include <cmath>
 #include <iostream>
+#include <mutex>
+#include <string>
+#include <vector>
 #include "material.h"
 
 class Camera{
@@ -22,14 +37,17 @@ class Camera{
     Vec3 u, v, w; //camera frame basis vectors//
     Vec3 defocus_disk_u; //defocus disk/lens horizontal radius//
     Vec3 defocus_disk_v; //defocus disk/lens vertical radius//
+    int tiles_x, tiles_y; //number of tiles across and down the image//
+    shared_ptr<Thread_pool> pool; //worker threads, kept alive between renders//
+    Framebuffer framebuffer; //linear colors of the last render//
+    Aov_buffers aov; //first hit albedo, normal and depth of the last render, when asked for//
+
+    bool cancelled() const{
+        return cancel && cancel->load(std::memory_order_relaxed);
+    }
 
     void initialize(){
-        image_height = int(image_width/aspect_ratio);
-        if(image_height < 1){
-            image_height = 1;
-        }else{
-            image_height *= 1;
-        }
+        image_height = output_height();
 
         pixel_samples_scale = 1.0 / samples_per_pixel;
 
@@ -63,11 +81,312 @@ class Camera{
         defocus_disk_u = u * defocus_radius;
         defocus_disk_v = v * defocus_radius;
 
+        // Every path traces at least its camera ray //
+        if(max_depth < 1){
+            max_depth = 1;
+        }
+
+        // Split the image into tiles //
+        if(tile_size < 1){
+            tile_size = 1;
+        }
+        tiles_x = (image_width + tile_size - 1) / tile_size;
+        tiles_y = (image_height + tile_size - 1) / tile_size;
+
+        // Create the worker threads, reusing the previous pool when the count is unchanged //
+        int thread_count = num_threads > 0 ? num_threads : Thread_pool::default_thread_count();
+        if(!pool || pool->size() != thread_count){
+            pool = make_shared<Thread_pool>(thread_count);
+        }
+    }
+
+    template <typename Scene_type>
+    void render_tile(const Scene_type& scene, int tile, Framebuffer& framebuffer){
+        RT_STAT_TIMER("tile");
+        int x0 = (tile % tiles_x) * tile_size;
+        int y0 = (tile / tiles_x) * tile_size;
+        int x1 = std::min(x0 + tile_size, image_width);
+        int y1 = std::min(y0 + tile_size, image_height);
+
+        if(wavefront){
+            render_tile_wavefront(scene, x0, y0, x1, y1, framebuffer);
+            return;
+        }
+
+        for(int j=y0; j<y1; j++){
+            if(packet_tracing){
+                for(int i=x0; i<x1; i += Ray_packet::size){
+                    render_packet(scene, i, std::min(Ray_packet::size, x1-i), j, &framebuffer.at(i, j));
+                }
+                continue;
+            }
+            for(int i=x0; i<x1; i++){
+                Color3 pixel_color(0,0,0);
+                for (int sample = 0; sample < samples_per_pixel; sample++) {
+                    pixel_color += sample_pixel(scene, i, j, sample);
+                }
+                framebuffer.at(i, j) = pixel_samples_scale * pixel_color;
+            }
+        }
+    }
+
+    // Average the first hit of aov_samples jittered camera rays per pixel into aov. The rays use //
+    // streams of their own, so asking for the buffers leaves the image unchanged. //
+    template <typename Scene_type>
+    void render_aovs(const Scene_type& scene){
+        RT_STAT_TIMER("aov");
+        aov.resize(image_width, image_height);
+        int samples = std::max(aov_samples, 1);
+        std::uint64_t aov_seed = ~seed;
+        pool->run(image_height, [&](int j, int){
+            for(int i=0; i<image_width; i++){
+                Color3 albedo(0,0,0);
+                Vec3 normal(0,0,0);
+                double depth = 0;
+                for(int sample=0; sample<samples; sample++){
+                    start_sample(Sampler_type::random, aov_seed, std::uint64_t(j)*image_width + i, sample, samples);
+                    Ray r = get_ray(i, j);
+                    Hit_record rec;
+                    if(scene.hit(r, Interval(0.001, infinity), rec)){
+                        albedo += scene.base_color(rec);
+                        normal += rec.N;
+                        depth += rec.t * r.direction().length();
+                    }else{
+                        albedo += Color3(1, 1, 1);
+                    }
+                }
+                size_t k = size_t(j)*image_width + i;
+                aov.albedo[k] = albedo / samples;
+                aov.normal[k] = normal / samples;
+                aov.depth[k] = float(depth / samples);
+            }
+        });
+    }
+
+    template <typename Scene_type>
+    Color3 sample_pixel(const Scene_type& scene, int i, int j, int sample) const{
+        // Each sample of each pixel gets its own stream, so the image only depends on the seed //
+        start_sample(sampler, seed, std::uint64_t(j)*image_width + i, sample, samples_per_pixel);
+        Ray r = get_ray(i, j);
+        return ray_color(r, scene, max_depth);
+    }
+
+    // Take one more pass of samples for every unconverged pixel of the tile, true once all have converged. //
+    // The first pass takes min_samples at once, so a tile visited once is never left unsampled. //
+    template <typename Scene_type>
+    bool render_tile_adaptive(const Scene_type& scene, int tile){
+        RT_STAT_TIMER("adaptive_tile");
+        int x0 = (tile % tiles_x) * tile_size;
+        int y0 = (tile / tiles_x) * tile_size;
+        int x1 = std::min(x0 + tile_size, image_width);
+        int y1 = std::min(y0 + tile_size, image_height);
+
+        bool tile_converged = true;
+        for(int j=y0; j<y1; j++){
+            for(int i=x0; i<x1; i++){
+                Pixel_stats& stats = framebuffer.stats[size_t(j)*image_width + i];
+                if(stats.converged){
+                    continue;
+                }
+                int step = stats.count == 0 ? std::max(pass_samples, min_samples) : pass_samples;
+                int last = std::min(stats.count + std::max(step, 1), samples_per_pixel);
+                for(int sample = stats.count; sample < last; sample++){
+                    stats.add(sample_pixel(scene, i, j, sample));
+                }
+                framebuffer.at(i, j) = stats.mean;
+
+                // The display is gamma 2, so an error e in luminance L shows up as about e / (2 sqrt(L)) //
+                double display_error = std::sqrt(stats.mean_variance()) / (2 * std::sqrt(std::fmax(luminance(stats.mean), 1e-4)));
+                stats.converged = stats.count >= samples_per_pixel
+                               || (stats.count >= min_samples && display_error <= noise_threshold);
+                tile_converged = tile_converged && stats.converged;
+            }
+        }
+        return tile_converged;
+    }
+
+    // Render in passes, dropping tiles once every pixel in them is below the noise threshold //
+    template <typename Scene_type>
+    void render_adaptive(const Scene_type& scene){
+        auto start = std::chrono::steady_clock::now();
+        framebuffer.reset_stats();
+
+        std::vector<int> active(tiles_x * tiles_y);
+        for(int tile=0; tile<int(active.size()); tile++){
+            active[tile] = tile;
+        }
+
+        int pass = 0;
+        bool out_of_time = false;
+        while(!active.empty() && !out_of_time){
+            std::vector<char> converged(active.size(), 0);
+            std::atomic<bool> over_budget(false);
+            pool->run(int(active.size()), [&](int task, int){
+                if(cancelled()){
+                    over_budget.store(true, std::memory_order_relaxed);
+                    return;
+                }
+                // The budget only cuts refinement short: pass 0 gives every tile its min_samples //
+                if(time_budget > 0 && pass > 0){
+                    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+                    if(elapsed.count() > time_budget){
+                        over_budget.store(true, std::memory_order_relaxed);
+                        return;
+                    }
+                }
+                converged[task] = render_tile_adaptive(scene, active[task]);
+            });
+            out_of_time = over_budget.load();
+
+            std::vector<int> still_active;
+            for(size_t k=0; k<active.size(); k++){
+                if(!converged[k]){
+                    still_active.push_back(active[k]);
+                }
+            }
+            active.swap(still_active);
+            pass++;
+            if(quiet){
+                continue;
+            }
+            std::clog << "\rPass " << pass << ", tiles converged: "
+                      << int(100.0 * (tiles_x*tiles_y - int(active.size())) / (tiles_x*tiles_y)) << "%" << ' ' << std::flush;
+        }
+
+        if(quiet){
+            return;
+        }
+        long long total = 0;
+        for(const auto& stats : framebuffer.stats){
+            total += stats.count;
+        }
+        std::clog << "\nAverage samples per pixel: " << double(total) / framebuffer.stats.size()
+                  << (out_of_time ? " (time budget reached)" : "") << "\n";
+    }
+
+    template <typename Scene_type>
+    void render_packet(const Scene_type& scene, int i0, int count, int j, Color3* out) const{
+        // Trace the camera rays of count neighbouring pixels as one packet, then follow each path alone //
+        Color3 pixel_colors[Ray_packet::size];
+        Rng lane_rng[Ray_packet::size];
+        Sample_state lane_sample[Ray_packet::size];
+        for (int sample = 0; sample < samples_per_pixel; sample++) {
+            Ray_packet rays;
+            rays.count = count;
+            for(int lane=0; lane<count; lane++){
+                start_sample(sampler, seed, std::uint64_t(j)*image_width + i0 + lane, sample, samples_per_pixel);
+                rays.set(lane, get_ray(i0 + lane, j));
+                // Keep each lane's stream so its path continues exactly like the single ray path //
+                lane_rng[lane] = random_generator();
+                lane_sample[lane] = sample_state();
+            }
+
+            Packet_hit hits(rays, Interval(0.001, infinity));
+            scene.hit_packet(rays, hits);
+
+            for(int lane=0; lane<count; lane++){
+                random_generator() = lane_rng[lane];
+                sample_state() = lane_sample[lane];
+                pixel_colors[lane] += ray_color(rays.ray(lane), hits.hit[lane], hits.rec[lane], scene, max_depth);
+            }
+        }
+        for(int lane=0; lane<count; lane++){
+            out[lane] = pixel_samples_scale * pixel_colors[lane];
+        }
+    }
+
+    template <typename Scene_type>
+    void render_tile_wavefront(const Scene_type& scene, int x0, int y0, int x1, int y1, Framebuffer& framebuffer) const{
+        // One path per pixel sample of the tile, all advanced a bounce at a time //
+        thread_local Wavefront_queue queue;
+        thread_local std::vector<Color3> results;
+        int width = x1 - x0;
+        results.assign(size_t(width) * (y1-y0) * samples_per_pixel, Color3(0,0,0));
+
+        queue.clear();
+        for(int j=y0; j<y1; j++){
+            for(int i=x0; i<x1; i++){
+                for (int sample = 0; sample < samples_per_pixel; sample++) {
+                    start_sample(sampler, seed, std::uint64_t(j)*image_width + i, sample, samples_per_pixel);
+                    Ray r = get_ray(i, j);
+                    auto slot = std::uint32_t(((j-y0)*width + (i-x0)) * samples_per_pixel + sample);
+                    queue.paths.push_back(Wavefront_path{r, Color3(1.0,1.0,1.0), Color3(0,0,0), 0, random_generator(), sample_state(), slot});
+                }
+            }
+        }
+
+        Ray scattered;
+        Color3 attenuation;
+        for(int bounce=0; bounce<max_depth && !queue.empty(); bounce++){
+            if(bounce > 0){
+                RT_STAT_ADD(Stat::secondary_rays, queue.paths.size());
+            }
+            queue.intersect(scene, Interval(0.001, infinity));
+
+            for(auto k : queue.misses){
+                Wavefront_path& path = queue.paths[k];
+                results[path.slot] = path.radiance + path.throughput * background(path.ray);
+                queue.alive[k] = 0;
+                RT_STAT_PATH_DEPTH(bounce + 1);
+            }
+
+            // Paths come grouped by material, so each scatter kernel runs over a contiguous batch //
+            for(auto k : queue.order){
+                Wavefront_path& path = queue.paths[k];
+                const Hit_record& rec = queue.hits[k];
+                random_generator() = path.rng;
+                sample_state() = path.sample;
+                path.radiance += path.throughput * emitted_light(scene, path.ray, rec, path.scatter_pdf);
+                start_bounce(bounce);
+                RT_STAT_SCATTER(rec.mat);
+                if(scene.scatter(path.ray, rec, attenuation, scattered)){
+                    path.radiance += path.throughput * direct_light(scene, path.ray, rec, bounce);
+                    path.scatter_pdf = scatter_density(scene, path.ray, rec, scattered);
+                    path.ray = scattered;
+                    path.throughput = path.throughput * attenuation;
+                    if(survives_roulette(bounce, path.throughput)){
+                        path.rng = random_generator();
+                        path.sample = sample_state();
+                    }else{
+                        results[path.slot] = path.radiance;
+                        queue.alive[k] = 0;
+                        RT_STAT_ADD(Stat::roulette_ended, 1);
+                        RT_STAT_PATH_DEPTH(bounce + 1);
+                    }
+                }else{
+                    results[path.slot] = path.radiance;
+                    queue.alive[k] = 0;
+                    RT_STAT_PATH_DEPTH(bounce + 1);
+                }
+            }
+
+            queue.compact();
+        }
+
+        // Paths still bouncing after the last allowed bounce end like ray_color's loop //
+        for(const auto& path : queue.paths){
+            results[path.slot] = path.radiance + path.throughput * background(path.ray);
+            RT_STAT_ADD(Stat::depth_limited, 1);
+            RT_STAT_PATH_DEPTH(max_depth);
+        }
+
+        // Sum in sample order so the result matches the single path integrator //
+        for(int j=y0; j<y1; j++){
+            for(int i=x0; i<x1; i++){
+                Color3 pixel_color(0,0,0);
+                size_t first = (size_t((j-y0)*width + (i-x0))) * samples_per_pixel;
+                for (int sample = 0; sample < samples_per_pixel; sample++) {
+                    pixel_color += results[first + sample];
+                }
+                framebuffer.at(i, j) = pixel_samples_scale * pixel_color;
+            }
+        }
     }
 
     Ray get_ray(int i, int j) const {
             // Construct a camera ray originating from the defocus disk and directed at randomly sampled
             // point around the pixel location i, j.
+            RT_STAT_ADD(Stat::camera_rays, 1);
 
             auto offset = sample_square();
             auto pixel_sample = pixel00_loc
@@ -82,11 +401,12 @@ class Camera{
 
         Vec3 sample_square() const {
             // Returns the vector to a random point in the [-.5,-.5]-[+.5,+.5] unit square.
-            return Vec3(random_double() - 0.5, random_double() - 0.5, 0);
+            Sample_2d s = sample_2d();
+            return Vec3(s.u - 0.5, s.v - 0.5, 0);
         }
 
         Point3 defocus_disk_sample() const {
-            auto p = random_in_unit_disk();
+            auto p = sample_unit_disk();
             return camera_center + (p[0] * defocus_disk_u) + (p[1] * defocus_disk_v);
         }
 
@@ -109,27 +429,130 @@ class Camera{
         }
     }*/
 
-    Color3 ray_color(Ray r, const Hittable& world, int depth){
-        Color3 col(1.0,1.0,1.0);
+    template <typename Scene_type>
+    Color3 ray_color(const Ray& r, const Scene_type& scene, int depth) const{
         Hit_record rec;
+        bool hit = depth > 0 && scene.hit(r, Interval(0.001, infinity), rec);
+        return ray_color(r, hit, rec, scene, depth);
+    }
+
+    // Russian roulette after the path's scatter at bounce: from min_bounces on, the path goes on //
+    // with probability p and is weighted up by 1/p, so the image stays unbiased while paths that //
+    // could add little stop early. p is the largest throughput channel over 0.1, so only paths //
+    // below that are likely to end; going on with the throughput itself added more noise than it //
+    // saved rays on the test scenes. p is at most 0.95, so paths losing nothing, like those //
+    // trapped in clear glass, end as well. //
+    bool survives_roulette(int bounce, Color3& throughput) const{
+        if(bounce < min_bounces){
+            return true;
+        }
+        double p = std::fmin(std::fmax(throughput[0], std::fmax(throughput[1], throughput[2])) / 0.1, 0.95);
+        if(roulette_sample(bounce) >= p){
+            return false;
+        }
+        throughput /= real(p);
+        return true;
+    }
+
+    // Light the surface rec gives off along r. Where the scatter before could pick r, with density //
+    // scatter_pdf, and light sampling could have found the same point, the power heuristic weighs //
+    // the two against each other. Camera rays, mirrors and glass leave all of it to this hit. //
+    template <typename Scene_type>
+    Color3 emitted_light(const Scene_type& scene, const Ray& r, const Hit_record& rec, double scatter_pdf) const{
+        Color3 emitted = scene.emitted(rec);
+        if(scatter_pdf > 0 && (emitted[0] > 0 || emitted[1] > 0 || emitted[2] > 0)){
+            emitted *= real(power_heuristic(scatter_pdf, scene.lights().pdf(r.origin(), rec, emitted)));
+        }
+        return emitted;
+    }
+
+    // Next event estimation: light reaching rec straight from a point picked on the scene's light //
+    // list, weighed against the scatter picking the same direction. Mirrors and glass take none. //
+    template <typename Scene_type>
+    Color3 direct_light(const Scene_type& scene, const Ray& r, const Hit_record& rec, int bounce) const{
+        const Light_list& lights = scene.lights();
+        if(lights.empty()){
+            return Color3(0,0,0);
+        }
+        start_light_sample(bounce);
+        double pick = sample_1d();
+        Sample_2d point = sample_2d();
+        Light_sample light;
+        Color3 f_cos;
+        double scatter_pdf;
+        if(!lights.sample(rec.P, pick, point, light) || !scene.evaluate(r, rec, light.direction, f_cos, scatter_pdf)
+           || !(scatter_pdf > 0)){
+            return Color3(0,0,0);
+        }
+        RT_STAT_ADD(Stat::shadow_rays, 1);
+        real distance = light.direction.length();
+        Hit_record blocker;
+        if(scene.hit(Ray(rec.P, light.direction / distance), Interval(0.001, distance - real(0.001)), blocker)){
+            return Color3(0,0,0);
+        }
+        return real(power_heuristic(light.pdf, scatter_pdf) / light.pdf) * f_cos * light.radiance;
+    }
+
+    // Density the scatter from rec picked scattered with, for weighing a light it hits; 0 for //
+    // mirrors and glass, and when the scene has no lights to sample //
+    template <typename Scene_type>
+    double scatter_density(const Scene_type& scene, const Ray& r, const Hit_record& rec, const Ray& scattered) const{
+        Color3 f_cos;
+        double pdf;
+        if(scene.lights().empty() || !scene.evaluate(r, rec, scattered.direction(), f_cos, pdf)){
+            return 0;
+        }
+        return pdf;
+    }
+
+    // Continue a path whose first intersection is already known, e.g. from a packet query //
+    template <typename Scene_type>
+    Color3 ray_color(Ray r, bool hit, Hit_record& rec, const Scene_type& scene, int depth) const{
+        Color3 col(1.0,1.0,1.0);
+        Color3 radiance(0,0,0);
+        double scatter_pdf = 0;
         Color3 attenuation;
         Ray scattered;
-        for(int bounce=0; bounce<depth; bounce++){
-            if (world.hit(r, Interval(0.001, infinity), rec)){
-                if(rec.mat->scatter(r, rec, attenuation, scattered)){
-                    r = scattered;
-                    col = col * attenuation;
-                }else{
-                    break;
-                }
-            }else{
+        int bounce = 0;
+        for(; bounce<depth; bounce++){
+            if(bounce > 0){
+                RT_STAT_ADD(Stat::secondary_rays, 1);
+                hit = scene.hit(r, Interval(0.001, infinity), rec);
+            }
+            if(!hit){
                 break;
             }
+            radiance += col * emitted_light(scene, r, rec, scatter_pdf);
+            start_bounce(bounce);
+            RT_STAT_SCATTER(rec.mat);
+            if(!scene.scatter(r, rec, attenuation, scattered)){
+                // Lights absorb what reaches them //
+                RT_STAT_PATH_DEPTH(bounce + 1);
+                return radiance;
+            }
+            radiance += col * direct_light(scene, r, rec, bounce);
+            scatter_pdf = scatter_density(scene, r, rec, scattered);
+            r = scattered;
+            col = col * attenuation;
+            if(!survives_roulette(bounce, col)){
+                RT_STAT_ADD(Stat::roulette_ended, 1);
+                RT_STAT_PATH_DEPTH(bounce + 1);
+                return radiance;
+            }
+        }
+        // Rays traced: one per bounce started, all depth of them when the loop ran out //
+        if(bounce == depth){
+            RT_STAT_ADD(Stat::depth_limited, 1);
         }
+        RT_STAT_PATH_DEPTH(std::min(bounce + 1, depth));
+        return radiance + col * background(r);
+    }
+
+    Color3 background(const Ray& r) const{
         //Background color//
         Vec3 unit_direction = unit_vector(r.direction());
         auto a = 0.5*(unit_direction[1] + 1.0);
-        return col * ((1.0-a)*Color3(1.0, 1.0, 1.0) + a*Color3(0.1, 0.3, 1.0));
+        return (1.0-a)*Color3(1.0, 1.0, 1.0) + a*Color3(0.1, 0.3, 1.0);
     }
 
     public:
@@ -143,25 +566,120 @@ class Camera{
     Vec3 vup = Vec3(0,1,0); //up vector//
     double defocus_angle = 0; //variation angle of rays through each pixel//
     double focus_dist = 10; //distance between camera lookfrom (center) to the focal plane//
+    int num_threads = 0; //number of render threads, 0 uses every hardware thread//
+    int tile_size = 32; //width and height in pixels of the square tiles handed to threads//
+    bool packet_tracing = false; //trace camera rays of neighbouring pixels together as ray packets//
+    bool wavefront = false; //advance all paths of a tile together, scattering them in batches per material//
+    int max_depth = 100; //rays a path may trace, the camera ray included//
+    int min_bounces = 3; //bounces before Russian roulette may end a path, max_depth or more turns it off//
+    std::uint64_t seed = 0; //base seed of the per pixel random streams//
+    Sampler_type sampler = Sampler_type::random; //how the sample values of each pixel are spread, see sampler.h//
+    bool adaptive = false; //render in passes (single ray paths) and stop sampling pixels once they are below noise_threshold//
+    int pass_samples = 4; //samples added to each unconverged pixel per adaptive pass//
+    int min_samples = 8; //samples every pixel gets before its noise is trusted//
+    double noise_threshold = 0.01; //acceptable standard error of a pixel on the 0-1 display scale//
+    double time_budget = 0; //seconds after which an adaptive render stops refining, 0 for no limit//
+    Image_format output_format = Image_format::ppm_ascii; //encoding of the written image//
+    std::string output_path; //file the image is written to, standard output when empty//
+    bool quiet = false; //no progress or timing output on std::clog//
+    const std::atomic<bool>* cancel = nullptr; //once set, renders skip the tiles and rows they have not started//
+    bool aov_buffers = false; //also render first hit albedo, normal and depth, see aovs()//
+    int aov_samples = 4; //jittered rays per pixel averaged into those buffers//
+    bool denoise = false; //filter the image guided by the aov buffers after rendering//
+    Denoise_options denoise_options;
 
-    void render(const Hittable& world){
-        // Start time //
-        auto start = std::chrono::high_resolution_clock::now();
+    // Height in pixels of the rendered image //
+    int output_height() const{
+        int height = int(image_width/aspect_ratio);
+        return height < 1 ? 1 : height;
+    }
 
+    // Sum the samples [job.first_sample, job.first_sample + job.sample_count) of each pixel in the //
+    // job's rectangle into partial, for adding up with other jobs of the frame. Follows the single //
+    // ray path; every mode gives the same samples. //
+    template <typename Scene_type>
+    void render_region(const Scene_type& scene, const Render_job& job, Partial_image& partial){
+        RT_STAT_TIMER("render_region");
         initialize();
-
-        std::cout<<"P3"<<"\n"<<image_width<<" "<<image_height<<"\n"<<"255"<<"\n";
-        for(int j=0; j<image_height; j++){
-            std::clog << "\rRendering done: " << int((j*1.0/image_height)*100) << "%" << ' ' << std::flush;
-            for(int i=0; i<image_width; i++){
+        partial.reset(image_width, image_height, job);
+        const Render_job& region = partial.job;
+        pool->run(region.y1 - region.y0, [&](int row, int){
+            if(cancelled()){
+                return;
+            }
+            RT_STAT_TIMER("row");
+            int j = region.y0 + row;
+            for(int i=region.x0; i<region.x1; i++){
                 Color3 pixel_color(0,0,0);
-                for (int sample = 0; sample < samples_per_pixel; sample++) {
-                    Ray r = get_ray(i, j);
-                    pixel_color += ray_color(r, world, 100);
+                for(int sample = region.first_sample; sample < region.first_sample + region.sample_count; sample++){
+                    pixel_color += sample_pixel(scene, i, j, sample);
+                }
+                partial.set(i, j, pixel_color, std::uint32_t(std::max(region.sample_count, 0)));
+            }
+        });
+    }
+
+    // Render into the framebuffer without writing the image out //
+    template <typename Scene_type>
+    void render_image(const Scene_type& scene){
+        RT_STAT_TIMER("render_image");
+        initialize();
+
+        // Render every tile, workers steal tiles from each other once their own run out //
+        framebuffer.resize(image_width, image_height);
+        if(adaptive){
+            render_adaptive(scene);
+        }else{
+            int tile_count = tiles_x * tiles_y;
+            std::atomic<int> tiles_done(0);
+            std::mutex progress;
+            auto print_progress = [&]{
+                int done = tiles_done.load(std::memory_order_relaxed);
+                std::clog << "\rRendering done: " << int((done*1.0/tile_count)*100) << "%" << ' ' << std::flush;
+            };
+            pool->run(tile_count, [&](int tile, int){
+                if(cancelled()){
+                    return;
+                }
+                render_tile(scene, tile, framebuffer);
+                tiles_done.fetch_add(1, std::memory_order_relaxed);
+                // Whichever worker finishes a tile reports, unless another is printing right now, //
+                // so the progress line never interleaves and no worker waits on it //
+                if(!quiet && progress.try_lock()){
+                    print_progress();
+                    progress.unlock();
                 }
-                write_color(std::cout, pixel_samples_scale * pixel_color);
+            });
+            // The last tiles may have finished while another worker held the lock //
+            if(!quiet){
+                print_progress();
             }
         }
+
+        if((aov_buffers || denoise) && !cancelled()){
+            render_aovs(scene);
+        }
+        if(denoise && !cancelled()){
+            Denoise_options options = denoise_options;
+            options.samples_per_pixel = samples_per_pixel;
+            ::denoise(framebuffer, aov, *pool, options);
+        }
+    }
+
+    template <typename Scene_type>
+    void render(const Scene_type& scene){
+        // Start time //
+        auto start = std::chrono::high_resolution_clock::now();
+
+        render_image(scene);
+
+        RT_STAT_TIMER("write_image");
+        if(!write_image(framebuffer, output_format, output_path)){
+            std::clog << "\nCould not write the image to " << (output_path.empty() ? "standard output" : output_path) << "\n";
+        }
+        if(quiet){
+            return;
+        }
         // Stop time and measure //
         auto stop = std::chrono::high_resolution_clock::now();
 
@@ -186,5 +704,15 @@ class Camera{
         std::clog << "\rDone.                         \n";
     }
 
+    // Linear colors of the last rendered image //
+    const Framebuffer& image() const{
+        return framebuffer;
+    }
+
+    // Albedo, normal and depth of the last render_image with aov_buffers or denoise set //
+    const Aov_buffers& aovs() const{
+        return aov;
+    }
+
 };
 #endif
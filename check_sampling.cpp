@@ -0,0 +1,128 @@
+#include "onb.h"
+#include "rtweekend.h"
+#include "vec3.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+// Checks that the closed-form sphere, disk and cosine maps of vec3.h, scalar and batch, draw the //
+// distributions they are meant to. Each check fills a histogram of bins that are equally likely //
+// under the target distribution and compares it to the expected even counts with a chi-square //
+// test. The statistic is turned into a standard normal score with the Wilson-Hilferty //
+// approximation; a check fails on |z| > 4, about one chance in 30000 by luck, and the program //
+// then exits nonzero. Runs under ctest; the seed is fixed, so a pass stays a pass. //
+
+constexpr int radial_bins = 16, angle_bins = 16;
+constexpr int bin_count = radial_bins * angle_bins;
+constexpr int samples = 1 << 20;
+constexpr int batch_size = 1024;
+
+// Bins are the square of a radius or cosine by the angle about the axis, both uniform for all //
+// three distributions //
+static int distribution_bin(double radial, double x, double y){
+    int i = std::clamp(int(radial * radial_bins), 0, radial_bins - 1);
+    double turns = std::atan2(y, x) / (2 * pi) + 0.5;
+    int j = std::clamp(int(turns * angle_bins), 0, angle_bins - 1);
+    return i * angle_bins + j;
+}
+
+// Sphere: z is uniform in [-1, 1] //
+static int sphere_bin(double x, double y, double z){
+    return distribution_bin(0.5 * (z + 1), x, y);
+}
+
+// Disk: the squared radius is uniform //
+static int disk_bin(double x, double y){
+    return distribution_bin(x*x + y*y, x, y);
+}
+
+// Cosine weighted: the squared cosine to the normal is uniform //
+static int cosine_bin(double x, double y, double z){
+    return distribution_bin(z * z, x, y);
+}
+
+// Standard normal score of the histogram against even counts //
+static double z_score(const std::vector<long long>& counts){
+    const double expected = double(samples) / bin_count;
+    double chi2 = 0;
+    for(auto count : counts){
+        double difference = double(count) - expected;
+        chi2 += difference * difference / expected;
+    }
+    const double dof = bin_count - 1;
+    return (std::cbrt(chi2 / dof) - (1 - 2 / (9 * dof))) / std::sqrt(2 / (9 * dof));
+}
+
+// Print the result of one check, true when it passed //
+static bool report(const char* name, const std::vector<long long>& counts){
+    double z = z_score(counts);
+    bool pass = std::fabs(z) <= 4;
+    std::printf("%-16s z = %6.2f  %s\n", name, z, pass ? "ok" : "FAILED, distributions differ");
+    return pass;
+}
+
+// Histogram of samples draws of bin_of() //
+template <typename Fn>
+static std::vector<long long> histogram(Fn&& bin_of){
+    std::vector<long long> counts(bin_count);
+    seed_random(1, 0);
+    for(int k=0; k<samples; k++){
+        counts[bin_of()]++;
+    }
+    return counts;
+}
+
+// Histogram of a batch map, fed batch_size uniform samples at a time; bin_of(k) bins output k //
+template <typename T, typename Map, typename Fn>
+static std::vector<long long> batch_histogram(Map&& map, Fn&& bin_of){
+    std::vector<long long> counts(bin_count);
+    std::vector<T> u(batch_size), v(batch_size);
+    seed_random(1, 0);
+    for(int done=0; done<samples; done+=batch_size){
+        for(int k=0; k<batch_size; k++){
+            u[k] = T(random_double());
+            v[k] = T(random_double());
+        }
+        map(u.data(), v.data());
+        for(int k=0; k<batch_size; k++){
+            counts[bin_of(k)]++;
+        }
+    }
+    return counts;
+}
+
+template <typename T>
+static bool check_batches(const char* sphere_name, const char* disk_name, const char* cosine_name){
+    std::vector<T> x(batch_size), y(batch_size), z(batch_size);
+    bool pass = report(sphere_name, batch_histogram<T>(
+        [&](const T* u, const T* v){ square_to_sphere(u, v, x.data(), y.data(), z.data(), batch_size); },
+        [&](int k){ return sphere_bin(x[k], y[k], z[k]); }));
+    pass &= report(disk_name, batch_histogram<T>(
+        [&](const T* u, const T* v){ square_to_disk(u, v, x.data(), y.data(), batch_size); },
+        [&](int k){ return disk_bin(x[k], y[k]); }));
+    pass &= report(cosine_name, batch_histogram<T>(
+        [&](const T* u, const T* v){ square_to_cosine_hemisphere(u, v, x.data(), y.data(), z.data(), batch_size); },
+        [&](int k){ return cosine_bin(x[k], y[k], z[k]); }));
+    return pass;
+}
+
+int main(){
+    bool pass = report("sphere", histogram([]{
+        Vec3 p = random_unit_vector();
+        return sphere_bin(p.x(), p.y(), p.z());
+    }));
+    pass &= report("disk", histogram([]{
+        Vec3 p = random_in_unit_disk();
+        return disk_bin(p.x(), p.y());
+    }));
+    // A tilted normal, so the Onb is checked too; directions are binned in the basis' own coordinates //
+    const Onb basis(unit_vector(Vec3(1, 2, 3)));
+    pass &= report("cosine", histogram([&]{
+        Vec3 d = basis.to_world(cosine_direction(random_double(), random_double()));
+        return cosine_bin(dot(d, basis.u), dot(d, basis.v), dot(d, basis.w));
+    }));
+    pass &= check_batches<float>("sphere batch f", "disk batch f", "cosine batch f");
+    pass &= check_batches<double>("sphere batch d", "disk batch d", "cosine batch d");
+    return pass ? 0 : 1;
+}
@@ -8,6 +8,11 @@
 
 using Color3 = Vec3;
 
+// Perceived brightness of a linear color (Rec. 709 weights) //
+inline double luminance(const Color3& c){
+    return 0.2126*c[0] + 0.7152*c[1] + 0.0722*c[2];
+}
+
 // Gamma correction //
 inline double linear_to_gamma(double linear_component)
 {
@@ -17,19 +22,20 @@ inline double linear_to_gamma(double linear_component)
     return 0;
 }
 
-void write_color(std::ostream &out, const Color3 &pixel_color){
-    auto r = linear_to_gamma(pixel_color[0]);
-    auto g = linear_to_gamma(pixel_color[1]);
-    auto b = linear_to_gamma(pixel_color[2]);
-
-    // Translate the 0-1 component values to 0-255 range //
+// Gamma correct a linear color and translate its 0-1 components to bytes //
+inline void color_to_bytes(const Color3 &pixel_color, unsigned char bytes[3]){
     static const Interval intensity(0.000, 0.999);
-    int rbyte = int(255.999 * intensity.clamp(r));
-    int gbyte = int(255.999 * intensity.clamp(g));
-    int bbyte = int(255.999 * intensity.clamp(b));
+    for(int c=0; c<3; c++){
+        bytes[c] = (unsigned char)(int(255.999 * intensity.clamp(linear_to_gamma(pixel_color[c]))));
+    }
+}
+
+inline void write_color(std::ostream &out, const Color3 &pixel_color){
+    unsigned char bytes[3];
+    color_to_bytes(pixel_color, bytes);
 
     // Write out the color values //
-    out<< rbyte <<" "<< gbyte <<" "<< bbyte <<"\n";
+    out<< int(bytes[0]) <<" "<< int(bytes[1]) <<" "<< int(bytes[2]) <<"\n";
 }
 
 #endif
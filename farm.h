@@ -0,0 +1,293 @@
+#ifndef FARM_H
+#define FARM_H
+
+#include "camera.h"
+#include "partial_image.h"
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define RT_HAVE_FARM 1
+#include <cerrno>
+#include <csignal>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+// Render farm: a coordinator splits a frame into Render_jobs and hands them to worker processes //
+// over pipes, one job at a time per worker so faster workers take more. A worker has loaded the //
+// scene itself and reads job lines on its standard input: //
+//   job x0 y0 x1 y1 first_sample sample_count //
+// answering each with a 64 bit byte count followed by the encoded Partial_image on its standard //
+// output. A result is only merged when its pixel extent and sample range are those of the job //
+// sent; jobs of workers that die or answer anything else are handed to the others. //
+
+// Serve jobs from in until it ends, 0 on success //
+template <typename Scene_type>
+int run_worker(const Scene_type& scene, Camera& cam, std::FILE* in, std::FILE* out){
+    char line[256];
+    Partial_image partial;
+    while(std::fgets(line, sizeof(line), in)){
+        Render_job job;
+        if(std::sscanf(line, "job %d %d %d %d %d %d", &job.x0, &job.y0, &job.x1, &job.y1,
+                       &job.first_sample, &job.sample_count) != 6){
+            std::cerr << "Worker: bad job line " << line;
+            return 1;
+        }
+        cam.render_region(scene, job, partial);
+        auto bytes = encode_partial(partial);
+        std::uint64_t size = bytes.size();
+        if(std::fwrite(&size, sizeof(size), 1, out) != 1
+           || std::fwrite(bytes.data(), 1, bytes.size(), out) != bytes.size() || std::fflush(out) != 0){
+            return 1;
+        }
+    }
+    return 0;
+}
+
+struct Farm_options{
+    int workers = 2;
+    int tile_size = 64; //side of the square tiles a frame is split into//
+    int sample_splits = 1; //sample ranges each tile is split into//
+    std::vector<std::string> worker_command; //program and arguments starting a worker//
+    bool quiet = false;
+};
+
+#ifdef RT_HAVE_FARM
+
+struct Farm_worker{
+    pid_t pid = -1;
+    int to = -1; //worker's standard input//
+    int from = -1; //worker's standard output//
+    int job = -1; //job being rendered, -1 when idle//
+    std::vector<unsigned char> inbox;
+
+    bool alive() const{
+        return pid > 0;
+    }
+
+    void stop(){
+        if(to >= 0) close(to);
+        if(from >= 0) close(from);
+        to = from = -1;
+        if(pid > 0){
+            waitpid(pid, nullptr, 0);
+        }
+        pid = -1;
+    }
+};
+
+inline bool start_worker(const std::vector<std::string>& command, Farm_worker& worker){
+    int input[2], output[2];
+    if(pipe(input) != 0){
+        return false;
+    }
+    if(pipe(output) != 0){
+        close(input[0]);
+        close(input[1]);
+        return false;
+    }
+    pid_t pid = fork();
+    if(pid == 0){
+        dup2(input[0], 0);
+        dup2(output[1], 1);
+        close(input[0]); close(input[1]);
+        close(output[0]); close(output[1]);
+        std::vector<char*> argv;
+        for(const auto& arg : command){
+            argv.push_back(const_cast<char*>(arg.c_str()));
+        }
+        argv.push_back(nullptr);
+        execvp(argv[0], argv.data());
+        _exit(127);
+    }
+    close(input[0]);
+    close(output[1]);
+    if(pid < 0){
+        close(input[1]);
+        close(output[0]);
+        return false;
+    }
+    // Later workers must not inherit these ends, or a worker would never see its input close //
+    fcntl(input[1], F_SETFD, FD_CLOEXEC);
+    fcntl(output[0], F_SETFD, FD_CLOEXEC);
+    worker.pid = pid;
+    worker.to = input[1];
+    worker.from = output[0];
+    return true;
+}
+
+inline bool write_all(int fd, const char* data, size_t size){
+    while(size > 0){
+        ssize_t written = write(fd, data, size);
+        if(written < 0 && errno == EINTR){
+            continue;
+        }
+        if(written <= 0){
+            return false;
+        }
+        data += written;
+        size -= size_t(written);
+    }
+    return true;
+}
+
+// Render a width x height frame of samples_per_pixel samples on local worker processes into result //
+inline bool run_farm(const Farm_options& options, int width, int height, int samples_per_pixel,
+                     Sample_accumulator& result, std::string& error){
+    // A worker dying while we write to it must show up as a failed write, not end the coordinator //
+    std::signal(SIGPIPE, SIG_IGN);
+
+    auto jobs = split_frame(width, height, samples_per_pixel, options.tile_size, options.sample_splits);
+    std::deque<int> pending;
+    for(int k=0; k<int(jobs.size()); k++){
+        pending.push_back(k);
+    }
+    result.reset(width, height);
+
+    std::vector<Farm_worker> workers(std::max(options.workers, 1));
+    for(auto& worker : workers){
+        if(!start_worker(options.worker_command, worker)){
+            error = "cannot start a worker process";
+            for(auto& started : workers){
+                started.stop();
+            }
+            return false;
+        }
+    }
+
+    auto fail_job = [&](Farm_worker& worker){
+        if(worker.job >= 0){
+            pending.push_front(worker.job);
+        }
+        worker.job = -1;
+        worker.stop();
+        if(!options.quiet){
+            std::clog << "\nA worker stopped, its job goes to the others\n";
+        }
+    };
+
+    size_t done = 0;
+    Partial_image partial;
+    while(done < jobs.size()){
+        // Hand a job to every idle worker //
+        for(auto& worker : workers){
+            if(!worker.alive() || worker.job >= 0 || pending.empty()){
+                continue;
+            }
+            int id = pending.front();
+            pending.pop_front();
+            const Render_job& job = jobs[id];
+            std::string line = "job " + std::to_string(job.x0) + " " + std::to_string(job.y0) + " "
+                             + std::to_string(job.x1) + " " + std::to_string(job.y1) + " "
+                             + std::to_string(job.first_sample) + " " + std::to_string(job.sample_count) + "\n";
+            worker.job = id;
+            if(!write_all(worker.to, line.data(), line.size())){
+                fail_job(worker);
+            }
+        }
+
+        std::vector<pollfd> fds;
+        std::vector<Farm_worker*> polled;
+        for(auto& worker : workers){
+            if(worker.alive() && worker.job >= 0){
+                fds.push_back({worker.from, POLLIN, 0});
+                polled.push_back(&worker);
+            }
+        }
+        if(fds.empty()){
+            if(!pending.empty()){
+                bool any_alive = false;
+                for(auto& worker : workers){
+                    any_alive = any_alive || worker.alive();
+                }
+                if(any_alive){
+                    continue;
+                }
+            }
+            error = "every worker stopped with " + std::to_string(jobs.size() - done) + " jobs left";
+            return false;
+        }
+        if(poll(fds.data(), fds.size(), -1) < 0){
+            if(errno == EINTR){
+                continue;
+            }
+            error = "poll failed";
+            for(auto& worker : workers){
+                worker.stop();
+            }
+            return false;
+        }
+
+        for(size_t k=0; k<fds.size(); k++){
+            if(!(fds[k].revents & (POLLIN | POLLHUP | POLLERR))){
+                continue;
+            }
+            Farm_worker& worker = *polled[k];
+            unsigned char chunk[65536];
+            ssize_t got = read(worker.from, chunk, sizeof(chunk));
+            if(got < 0 && errno == EINTR){
+                continue;
+            }
+            if(got <= 0){
+                fail_job(worker);
+                continue;
+            }
+            worker.inbox.insert(worker.inbox.end(), chunk, chunk + got);
+
+            std::uint64_t size = 0;
+            if(worker.inbox.size() < sizeof(size)){
+                continue;
+            }
+            std::memcpy(&size, worker.inbox.data(), sizeof(size));
+            if(worker.inbox.size() < sizeof(size) + size){
+                continue;
+            }
+            const Render_job& job = jobs[worker.job];
+            bool ok = worker.inbox.size() == sizeof(size) + size
+                   && decode_partial(worker.inbox.data() + sizeof(size), size_t(size), partial)
+                   && partial.job.x0 == job.x0 && partial.job.y0 == job.y0
+                   && partial.job.x1 == job.x1 && partial.job.y1 == job.y1
+                   && partial.job.first_sample == job.first_sample && partial.job.sample_count == job.sample_count
+                   && result.add(partial);
+            worker.inbox.clear();
+            if(!ok){
+                fail_job(worker);
+                continue;
+            }
+            worker.job = -1;
+            done++;
+            if(!options.quiet){
+                std::clog << "\rFarm jobs done: " << done << "/" << jobs.size() << ' ' << std::flush;
+            }
+        }
+    }
+
+    // Closing their input lets the workers finish //
+    for(auto& worker : workers){
+        worker.stop();
+    }
+    if(!options.quiet){
+        std::clog << "\n";
+    }
+    return done == jobs.size();
+}
+
+#else
+
+inline bool run_farm(const Farm_options&, int, int, int, Sample_accumulator&, std::string& error){
+    error = "farm mode needs a POSIX system";
+    return false;
+}
+
+#endif
+
+#endif
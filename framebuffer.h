@@ -0,0 +1,66 @@
+#ifndef FRAMEBUFFER_H
+#define FRAMEBUFFER_H
+
+#include "color.h"
+#include "rtweekend.h"
+#include <vector>
+
+// Running mean and variance of the samples of one pixel, updated with Welford's algorithm. //
+// The variance is tracked on luminance, which is what the noise estimate needs. //
+struct Pixel_stats{
+    int count = 0;
+    Color3 mean;
+    double m2 = 0; //sum of squared luminance differences from the mean//
+    bool converged = false;
+
+    void add(const Color3& sample){
+        double old_luminance = luminance(mean);
+        count++;
+        mean += (sample - mean) / count;
+        m2 += (luminance(sample) - old_luminance) * (luminance(sample) - luminance(mean));
+    }
+
+    // Estimated variance of the mean luminance, how far the pixel may still be from its final value //
+    double mean_variance() const{
+        if(count < 2){
+            return infinity;
+        }
+        return m2 / (count - 1) / count;
+    }
+};
+
+// Linear color of every pixel of the image, stored row by row from the top left //
+class Framebuffer{
+    public:
+    int width = 0;
+    int height = 0;
+    std::vector<Color3> pixels;
+    std::vector<Pixel_stats> stats; //per pixel sample statistics, only filled by progressive renders//
+
+    Framebuffer() {}
+    Framebuffer(int width, int height){
+        resize(width, height);
+    }
+
+    // Change the size, keeping the allocation when it is already large enough //
+    void resize(int w, int h){
+        width = w;
+        height = h;
+        pixels.assign(size_t(w) * h, Color3(0,0,0));
+    }
+
+    // Start progressive accumulation over, stats get the same size as the image //
+    void reset_stats(){
+        stats.assign(pixels.size(), Pixel_stats());
+    }
+
+    Color3& at(int i, int j){
+        return pixels[size_t(j)*width + i];
+    }
+
+    const Color3& at(int i, int j) const{
+        return pixels[size_t(j)*width + i];
+    }
+};
+
+#endif
@@ -1,18 +1,25 @@
 #ifndef  HITTABLE_H
 #define  HITTABLE_H
 
+#include "aabb.h"
 #include "interval.h"
 #include "ray.h"
+#include "ray_packet.h"
 #include "rtweekend.h"
 #include "vec3.h"
-class Material;
+#include <cstdint>
+#include <vector>
+
+// Index of a material in the scene's Material_table //
+using Material_id = std::uint32_t;
+
 class Hit_record{
     public:
     Point3 P;
     Vec3 N;
-    double t;
+    real t;
     bool front_face;
-    shared_ptr<Material> mat;
+    Material_id mat;
 
     void set_face_normal(const Ray& r, const Vec3& outward_normal){
         if(dot(r.direction(), outward_normal) > 0){
@@ -25,10 +32,53 @@ class Hit_record{
     }
 };
 
+// Results of a packet query, one closest distance and record per lane of a Ray_packet //
+class Packet_hit{
+    public:
+    real t_min;
+    real closest[Ray_packet::size];
+    bool hit[Ray_packet::size];
+    Hit_record rec[Ray_packet::size];
+
+    Packet_hit(const Ray_packet& rays, Interval ray_t) : t_min(ray_t.min) {
+        for(int lane=0; lane<Ray_packet::size; lane++){
+            // Unused lanes get an empty interval so no test can ever accept them //
+            closest[lane] = lane < rays.count ? ray_t.max : -infinity;
+            hit[lane] = false;
+        }
+    }
+};
+
+inline bool is_marked(const std::vector<char>& marked, Material_id mat){
+    return mat < marked.size() && marked[mat];
+}
+
 class Hittable{
     public:
     virtual ~Hittable() = default;
     virtual bool hit(const Ray& r, Interval ray_t, Hit_record& rec) const = 0;
+    virtual Aabb bounding_box() const = 0;
+
+    // Update cached bounds after objects inside moved, keeping the structure of any hierarchy. //
+    // Objects that never change have nothing to do. //
+    virtual void refit() {}
+
+    // Whether a primitive inside uses a material marked in marked, indexed by Material_id. The //
+    // scenes ask it to refuse emitting geometry their light list does not sample. //
+    virtual bool uses_marked_material(const std::vector<char>&) const{
+        return false;
+    }
+
+    // Intersect every lane of a packet, only accepting hits closer than hits.closest. //
+    // The default traces the lanes one by one, coherent structures override it. //
+    virtual void hit_packet(const Ray_packet& rays, Packet_hit& hits) const{
+        for(int lane=0; lane<rays.count; lane++){
+            if(hit(rays.ray(lane), Interval(hits.t_min, hits.closest[lane]), hits.rec[lane])){
+                hits.closest[lane] = hits.rec[lane].t;
+                hits.hit[lane] = true;
+            }
+        }
+    }
 };
 
 #endif
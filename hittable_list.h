@@ -1,6 +1,7 @@
 #ifndef HITTABLE_LIST_H
 #define HITTABLE_LIST_H
 
+#include "aabb.h"
 #include "hittable.h"
 #include "interval.h"
 
@@ -17,10 +18,14 @@ class Hittable_list : public Hittable {
     Hittable_list() {}
     Hittable_list(shared_ptr<Hittable> object) { add(object); }
 
-    void clear() { objects.clear(); }
+    void clear() {
+        objects.clear();
+        bbox = Aabb();
+    }
 
     void add(shared_ptr<Hittable> object) {
         objects.push_back(object);
+        bbox = Aabb(bbox, object->bounding_box());
     }
 
     bool hit(const Ray& r, Interval ray_t, Hit_record& rec) const override {
@@ -38,6 +43,34 @@ class Hittable_list : public Hittable {
 
         return hit_anything;
     }
+
+    void hit_packet(const Ray_packet& rays, Packet_hit& hits) const override {
+        for (const auto& object : objects) {
+            object->hit_packet(rays, hits);
+        }
+    }
+
+    Aabb bounding_box() const override { return bbox; }
+
+    bool uses_marked_material(const std::vector<char>& marked) const override {
+        for (const auto& object : objects) {
+            if (object->uses_marked_material(marked)) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void refit() override {
+        bbox = Aabb();
+        for (const auto& object : objects) {
+            object->refit();
+            bbox = Aabb(bbox, object->bounding_box());
+        }
+    }
+
+  private:
+    Aabb bbox;
 };
 
 #endif
@@ -0,0 +1,228 @@
+#ifndef IMAGE_IO_H
+#define IMAGE_IO_H
+
+#include "color.h"
+#include "framebuffer.h"
+#include <algorithm>
+#include <array>
+#include <charconv>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+// Image encoders writing a whole Framebuffer into one memory buffer, which is then written out //
+// with a single call. Byte formats are gamma corrected like write_color, PFM keeps linear floats. //
+
+enum class Image_format{
+    ppm_ascii, //P3 text, what write_color produces//
+    ppm_binary, //P6, 8 bits per channel//
+    png, //8 bit RGB, stored without compression//
+    pfm //32 bit float RGB, linear, for HDR compositing//
+};
+
+// Pick the format from a file name, .ppm files are written as binary P6 //
+inline Image_format image_format_from_path(const std::string& path, Image_format fallback){
+    auto ends_with = [&](const char* ext){
+        size_t n = std::strlen(ext);
+        return path.size() >= n && path.compare(path.size()-n, n, ext) == 0;
+    };
+    if(ends_with(".png")) return Image_format::png;
+    if(ends_with(".pfm")) return Image_format::pfm;
+    if(ends_with(".ppm")) return Image_format::ppm_binary;
+    return fallback;
+}
+
+inline bool image_format_from_name(const std::string& name, Image_format& format){
+    if(name == "p3") format = Image_format::ppm_ascii;
+    else if(name == "p6") format = Image_format::ppm_binary;
+    else if(name == "png") format = Image_format::png;
+    else if(name == "pfm") format = Image_format::pfm;
+    else return false;
+    return true;
+}
+
+inline void append_text(std::vector<unsigned char>& out, const std::string& text){
+    out.insert(out.end(), text.begin(), text.end());
+}
+
+inline void append_u32_be(std::vector<unsigned char>& out, std::uint32_t v){
+    out.push_back((unsigned char)(v >> 24));
+    out.push_back((unsigned char)(v >> 16));
+    out.push_back((unsigned char)(v >> 8));
+    out.push_back((unsigned char)(v));
+}
+
+inline std::vector<unsigned char> encode_ppm_ascii(const Framebuffer& image){
+    std::vector<unsigned char> out;
+    append_text(out, "P3\n" + std::to_string(image.width) + " " + std::to_string(image.height) + "\n255\n");
+    // At most "255 255 255\n" per pixel //
+    out.reserve(out.size() + image.pixels.size() * 12);
+    char text[4];
+    unsigned char bytes[3];
+    for(const auto& pixel : image.pixels){
+        color_to_bytes(pixel, bytes);
+        for(int c=0; c<3; c++){
+            auto end = std::to_chars(text, text + sizeof(text), int(bytes[c])).ptr;
+            out.insert(out.end(), text, end);
+            out.push_back(c < 2 ? ' ' : '\n');
+        }
+    }
+    return out;
+}
+
+inline std::vector<unsigned char> encode_ppm_binary(const Framebuffer& image){
+    std::vector<unsigned char> out;
+    append_text(out, "P6\n" + std::to_string(image.width) + " " + std::to_string(image.height) + "\n255\n");
+    size_t header = out.size();
+    out.resize(header + image.pixels.size() * 3);
+    for(size_t k=0; k<image.pixels.size(); k++){
+        color_to_bytes(image.pixels[k], &out[header + 3*k]);
+    }
+    return out;
+}
+
+inline std::uint32_t crc32(const unsigned char* data, size_t size, std::uint32_t crc = 0){
+    static const auto table = []{
+        std::array<std::uint32_t, 256> t;
+        for(std::uint32_t n=0; n<256; n++){
+            std::uint32_t c = n;
+            for(int k=0; k<8; k++){
+                c = (c & 1) ? 0xedb88320u ^ (c >> 1) : c >> 1;
+            }
+            t[n] = c;
+        }
+        return t;
+    }();
+    crc = ~crc;
+    for(size_t k=0; k<size; k++){
+        crc = table[(crc ^ data[k]) & 0xff] ^ (crc >> 8);
+    }
+    return ~crc;
+}
+
+inline void append_png_chunk(std::vector<unsigned char>& out, const char* type, const std::vector<unsigned char>& data){
+    append_u32_be(out, std::uint32_t(data.size()));
+    size_t start = out.size();
+    out.insert(out.end(), type, type + 4);
+    out.insert(out.end(), data.begin(), data.end());
+    append_u32_be(out, crc32(&out[start], out.size() - start));
+}
+
+inline std::vector<unsigned char> encode_png(const Framebuffer& image){
+    // Raw scanlines, each prefixed with filter type 0 //
+    size_t row_size = size_t(image.width) * 3 + 1;
+    std::vector<unsigned char> raw(row_size * image.height);
+    for(int j=0; j<image.height; j++){
+        raw[j*row_size] = 0;
+        for(int i=0; i<image.width; i++){
+            color_to_bytes(image.at(i, j), &raw[j*row_size + 1 + 3*i]);
+        }
+    }
+
+    // zlib stream made of stored deflate blocks of at most 65535 bytes //
+    std::vector<unsigned char> zlib = {0x78, 0x01};
+    for(size_t offset=0; offset<raw.size() || offset == 0; ){
+        size_t size = std::min<size_t>(65535, raw.size() - offset);
+        bool last = offset + size == raw.size();
+        zlib.push_back(last ? 1 : 0);
+        zlib.push_back((unsigned char)(size & 0xff));
+        zlib.push_back((unsigned char)(size >> 8));
+        zlib.push_back((unsigned char)(~size & 0xff));
+        zlib.push_back((unsigned char)((~size >> 8) & 0xff));
+        zlib.insert(zlib.end(), raw.begin() + offset, raw.begin() + offset + size);
+        offset += size;
+        if(last){
+            break;
+        }
+    }
+    std::uint32_t a = 1, b = 0;
+    for(auto byte : raw){
+        a = (a + byte) % 65521;
+        b = (b + a) % 65521;
+    }
+    append_u32_be(zlib, (b << 16) | a);
+
+    std::vector<unsigned char> out = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n'};
+    std::vector<unsigned char> ihdr;
+    append_u32_be(ihdr, std::uint32_t(image.width));
+    append_u32_be(ihdr, std::uint32_t(image.height));
+    ihdr.insert(ihdr.end(), {8, 2, 0, 0, 0}); // 8 bit depth, RGB, deflate, no filter, no interlace //
+    append_png_chunk(out, "IHDR", ihdr);
+    append_png_chunk(out, "IDAT", zlib);
+    append_png_chunk(out, "IEND", {});
+    return out;
+}
+
+inline std::vector<unsigned char> encode_pfm(const Framebuffer& image){
+    // Negative scale means little endian, rows go from the bottom up //
+    std::vector<unsigned char> out;
+    append_text(out, "PF\n" + std::to_string(image.width) + " " + std::to_string(image.height) + "\n-1.0\n");
+    size_t header = out.size();
+    out.resize(header + image.pixels.size() * 3 * sizeof(float));
+    unsigned char* data = &out[header];
+    for(int j=0; j<image.height; j++){
+        const Color3* row = &image.pixels[size_t(image.height-1-j) * image.width];
+        for(int i=0; i<image.width; i++){
+            float rgb[3] = {float(row[i][0]), float(row[i][1]), float(row[i][2])};
+            std::memcpy(data + sizeof(rgb)*(size_t(j)*image.width + i), rgb, sizeof(rgb));
+        }
+    }
+    return out;
+}
+
+// Read a PFM written by encode_pfm (little endian RGB) back into linear colors //
+inline bool read_pfm(const std::string& path, Framebuffer& image){
+    std::FILE* file = std::fopen(path.c_str(), "rb");
+    if(!file){
+        return false;
+    }
+    int width = 0, height = 0;
+    double scale = 0;
+    bool ok = std::fscanf(file, "PF %d %d %lf", &width, &height, &scale) == 3
+           && std::fgetc(file) != EOF && width > 0 && height > 0 && scale < 0;
+    std::vector<float> data;
+    if(ok){
+        data.resize(size_t(width) * height * 3);
+        ok = std::fread(data.data(), sizeof(float), data.size(), file) == data.size();
+    }
+    std::fclose(file);
+    if(!ok){
+        return false;
+    }
+    image.resize(width, height);
+    for(int j=0; j<height; j++){
+        const float* row = &data[size_t(height-1-j) * width * 3];
+        for(int i=0; i<width; i++){
+            image.at(i, j) = Color3(row[3*i], row[3*i+1], row[3*i+2]);
+        }
+    }
+    return true;
+}
+
+inline std::vector<unsigned char> encode_image(const Framebuffer& image, Image_format format){
+    switch(format){
+        case Image_format::ppm_binary: return encode_ppm_binary(image);
+        case Image_format::png: return encode_png(image);
+        case Image_format::pfm: return encode_pfm(image);
+        default: return encode_ppm_ascii(image);
+    }
+}
+
+// Encode the image and write it to path, or to standard output when path is empty //
+inline bool write_image(const Framebuffer& image, Image_format format, const std::string& path){
+    auto bytes = encode_image(image, format);
+    if(path.empty()){
+        std::fflush(stdout);
+        return std::fwrite(bytes.data(), 1, bytes.size(), stdout) == bytes.size() && std::fflush(stdout) == 0;
+    }
+    std::FILE* file = std::fopen(path.c_str(), "wb");
+    if(!file){
+        return false;
+    }
+    bool ok = std::fwrite(bytes.data(), 1, bytes.size(), file) == bytes.size();
+    return std::fclose(file) == 0 && ok;
+}
+
+#endif
@@ -0,0 +1,95 @@
+#ifndef INSTANCE_H
+#define INSTANCE_H
+
+#include "aabb.h"
+#include "hittable.h"
+#include "interval.h"
+#include "ray.h"
+#include "ray_packet.h"
+#include "rtweekend.h"
+#include "transform.h"
+#include "vec3.h"
+#include <cstdint>
+#include <memory>
+
+// Shared geometry placed in the world by a transform, optionally with its own material. Rays are //
+// taken into object space and hits brought back, so any number of instances reuse one copy of the //
+// geometry and its hierarchy. The ray direction is transformed without normalizing, so hit //
+// distances are the same in both spaces and one Interval serves both. With Geometry a final class //
+// such as Triangle_mesh the calls into it are direct; Instance works on any Hittable. //
+template <typename Geometry>
+class Instance_of final : public Hittable{
+    private:
+    shared_ptr<const Geometry> object;
+    Transform to_world;
+    Material_id mat;
+    Aabb bbox;
+
+    void to_world_space(Hit_record& rec) const{
+        // Transforming N keeps the sign of its dot product with the ray, so front_face stays valid //
+        rec.P = to_world.point(rec.P);
+        rec.N = unit_vector(to_world.normal(rec.N));
+        if(mat != keep_material){
+            rec.mat = mat;
+        }
+    }
+
+    public:
+    static constexpr Material_id keep_material = ~Material_id(0); //use the geometry's own materials//
+
+    Instance_of(shared_ptr<const Geometry> object, const Transform& to_world, Material_id mat = keep_material)
+        : object(object), to_world(to_world), mat(mat), bbox(to_world.box(object->bounding_box())) {}
+
+    bool hit(const Ray& r, Interval ray_t, Hit_record& rec) const override{
+        Ray local(to_world.inverse_point(r.origin()), to_world.inverse_vector(r.direction()));
+        if(!object->hit(local, ray_t, rec)){
+            return false;
+        }
+        to_world_space(rec);
+        return true;
+    }
+
+    void hit_packet(const Ray_packet& rays, Packet_hit& hits) const override{
+        // Trace the whole packet in object space, then bring back the lanes the geometry hit //
+        Ray_packet local = rays;
+        for(int lane=0; lane<rays.count; lane++){
+            Ray r = rays.ray(lane);
+            local.set(lane, Ray(to_world.inverse_point(r.origin()), to_world.inverse_vector(r.direction())));
+        }
+        Packet_hit local_hits = hits;
+        for(int lane=0; lane<Ray_packet::size; lane++){
+            local_hits.hit[lane] = false;
+        }
+        object->hit_packet(local, local_hits);
+        for(int lane=0; lane<rays.count; lane++){
+            if(local_hits.hit[lane]){
+                hits.rec[lane] = local_hits.rec[lane];
+                to_world_space(hits.rec[lane]);
+                hits.closest[lane] = local_hits.closest[lane];
+                hits.hit[lane] = true;
+            }
+        }
+    }
+
+    bool uses_marked_material(const std::vector<char>& marked) const override{
+        return mat != keep_material ? is_marked(marked, mat) : object->uses_marked_material(marked);
+    }
+
+    Aabb bounding_box() const override{
+        return bbox;
+    }
+
+    const Transform& transform() const{
+        return to_world;
+    }
+
+    // Move the instance; hierarchies above it need a refit() afterwards //
+    void set_transform(const Transform& t){
+        to_world = t;
+        bbox = to_world.box(object->bounding_box());
+    }
+};
+
+using Instance = Instance_of<Hittable>;
+
+#endif
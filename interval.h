@@ -4,23 +4,25 @@
 
 class Interval{
     public:
-    double min, max;
+    real min, max;
     Interval() : min(+infinity), max(-infinity){};
-    Interval(double min, double max) : min(min), max(max) {};
+    Interval(real min, real max) : min(min), max(max) {};
+    // Create the interval tightly enclosing the two input intervals //
+    Interval(const Interval& a, const Interval& b) : min(a.min <= b.min ? a.min : b.min), max(a.max >= b.max ? a.max : b.max) {};
 
-    double size()const{
+    real size()const{
         return max - min;
     }
 
-    bool contains(double x)const{
+    bool contains(real x)const{
         return min <= x && x <= max;
     }
 
-    bool surround(double x)const{
+    bool surround(real x)const{
         return min < x && x < max;
     }
 
-    double clamp(double x) const {
+    real clamp(real x) const {
         if(x < min){
             return min;
         }else if(x > max){
@@ -30,6 +32,11 @@ class Interval{
         }
     }
 
+    Interval expand(real delta) const{
+        auto padding = delta/2;
+        return Interval(min - padding, max + padding);
+    }
+
     static const Interval empty, universe;
 };
 
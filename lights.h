@@ -0,0 +1,125 @@
+#ifndef LIGHTS_H
+#define LIGHTS_H
+
+#include "color.h"
+#include "hittable.h"
+#include "rtweekend.h"
+#include "sampler.h"
+#include "vec3.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+// Area lights of a scene: the spheres and quads with an emitting material, which next event //
+// estimation picks points on. A light is picked with probability proportional to its power, the //
+// luminance of its radiance times its area, through a binary search of the running sums, so a //
+// pick costs a few steps even among thousands of lights. The point is then uniform over the //
+// light's area. The density of a point over all lights is so just its luminance over the total, //
+// whichever light it is on, and a hit on a light found by scattering needs no lookup of which //
+// light it was to weigh it against light sampling. //
+
+// A point picked on a light, seen from the shading point //
+struct Light_sample{
+    Vec3 direction; //from the shading point to the light point, not normalized//
+    Color3 radiance;
+    double pdf; //per solid angle at the shading point, the pick included//
+};
+
+class Light_list{
+    private:
+    struct Light{
+        bool sphere; //a sphere of radius around center, else a quad at corner with edges u and v//
+        Point3 corner;
+        Vec3 u, v;
+        real radius;
+        Color3 radiance;
+    };
+    std::vector<Light> lights;
+    std::vector<double> cumulative; //running sum of the powers, the last is the total//
+
+    void add(const Light& light, double area){
+        double power = luminance(light.radiance) * area;
+        if(!(power > 0)){
+            return;
+        }
+        lights.push_back(light);
+        cumulative.push_back(total_power() + power);
+    }
+
+    public:
+    bool empty() const{
+        return lights.empty();
+    }
+
+    size_t size() const{
+        return lights.size();
+    }
+
+    double total_power() const{
+        return cumulative.empty() ? 0 : cumulative.back();
+    }
+
+    // Lights shine from the front: the outside of spheres, the u x v side of quads //
+    void add_sphere(const Point3& center, real radius, const Color3& radiance){
+        add({true, center, Vec3(0, 0, 0), Vec3(0, 0, 0), radius, radiance}, 4 * pi * radius * radius);
+    }
+
+    void add_quad(const Point3& corner, const Vec3& u, const Vec3& v, const Color3& radiance){
+        add({false, corner, u, v, 0, radiance}, cross(u, v).length());
+    }
+
+    // Pick a light by pick and a point on it by s; false when the point faces away from from, //
+    // the far side of a sphere or the back of a quad //
+    bool sample(const Point3& from, double pick, const Sample_2d& s, Light_sample& out) const{
+        if(lights.empty()){
+            return false;
+        }
+        double target = pick * total_power();
+        size_t k = size_t(std::upper_bound(cumulative.begin(), cumulative.end(), target) - cumulative.begin());
+        const Light& light = lights[std::min(k, lights.size() - 1)];
+
+        Point3 point;
+        Vec3 normal;
+        if(light.sphere){
+            normal = sphere_direction(s.u, s.v);
+            point = light.corner + light.radius * normal;
+        }else{
+            point = light.corner + real(s.u) * light.u + real(s.v) * light.v;
+            normal = unit_vector(cross(light.u, light.v));
+        }
+        out.direction = point - from;
+        double distance_squared = out.direction.length_squared();
+        double cos_light = -dot(out.direction, normal) / std::sqrt(distance_squared);
+        if(!(cos_light > 0)){
+            return false;
+        }
+        out.radiance = light.radiance;
+        out.pdf = luminance(light.radiance) / total_power() * distance_squared / cos_light;
+        return true;
+    }
+
+    // Density sample() gives the point of rec, seen from from, when rec is the front of a light //
+    // of this radiance //
+    double pdf(const Point3& from, const Hit_record& rec, const Color3& radiance) const{
+        if(lights.empty()){
+            return 0;
+        }
+        Vec3 direction = rec.P - from;
+        double distance_squared = direction.length_squared();
+        double cos_light = std::fabs(dot(direction, rec.N)) / std::sqrt(distance_squared);
+        if(!(cos_light > 0)){
+            return 0;
+        }
+        return luminance(radiance) / total_power() * distance_squared / cos_light;
+    }
+};
+
+// Weight of a sample drawn with density pdf, when the other strategy would have drawn it with //
+// other_pdf (Veach's power heuristic) //
+inline double power_heuristic(double pdf, double other_pdf){
+    double a = pdf * pdf, b = other_pdf * other_pdf;
+    return a / (a + b);
+}
+
+#endif
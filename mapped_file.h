@@ -0,0 +1,102 @@
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <cstddef>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define RT_HAVE_MMAP 1
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// Read only view of a whole file. Memory mapped where the platform allows it, so pages are only //
+// read when touched and several processes loading the same scene share them; read into memory otherwise. //
+class Mapped_file{
+    private:
+    const unsigned char* bytes = nullptr;
+    size_t length = 0;
+    bool mapped = false;
+    std::vector<unsigned char> copy; //contents when the file could not be mapped//
+
+    void close(){
+#ifdef RT_HAVE_MMAP
+        if(mapped){
+            munmap(const_cast<unsigned char*>(bytes), length);
+        }
+#endif
+        bytes = nullptr;
+        length = 0;
+        mapped = false;
+        copy.clear();
+    }
+
+    public:
+    Mapped_file() {}
+    Mapped_file(const Mapped_file&) = delete;
+    Mapped_file& operator=(const Mapped_file&) = delete;
+
+    ~Mapped_file(){
+        close();
+    }
+
+    bool open(const std::string& path){
+        close();
+#ifdef RT_HAVE_MMAP
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if(fd < 0){
+            return false;
+        }
+        struct stat info;
+        if(fstat(fd, &info) != 0){
+            ::close(fd);
+            return false;
+        }
+        length = size_t(info.st_size);
+        if(length > 0){
+            void* address = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+            if(address != MAP_FAILED){
+                bytes = static_cast<const unsigned char*>(address);
+                mapped = true;
+            }
+        }
+        ::close(fd);
+        if(mapped || length == 0){
+            return true;
+        }
+#endif
+        std::FILE* file = std::fopen(path.c_str(), "rb");
+        if(!file){
+            return false;
+        }
+        bool ok = std::fseek(file, 0, SEEK_END) == 0;
+        long end = ok ? std::ftell(file) : -1;
+        ok = end >= 0 && std::fseek(file, 0, SEEK_SET) == 0;
+        if(ok){
+            copy.resize(size_t(end));
+            ok = std::fread(copy.data(), 1, copy.size(), file) == copy.size();
+        }
+        std::fclose(file);
+        if(!ok){
+            copy.clear();
+            return false;
+        }
+        bytes = copy.data();
+        length = copy.size();
+        return true;
+    }
+
+    const unsigned char* data() const{
+        return bytes;
+    }
+
+    size_t size() const{
+        return length;
+    }
+};
+
+#endif
@@ -4,8 +4,27 @@
 #include "hittable.h"
 #include "ray.h"
 #include "rtweekend.h"
+#include "sampler.h"
 #include "vec3.h"
 #include <cmath>
+#include <cstdint>
+#include <variant>
+#include <vector>
+
+// Plain description of a built-in material, what scene files store //
+struct Material_params{
+    enum class Kind : std::uint32_t{
+        lambertian,
+        metal,
+        dielectric,
+        diffuse_light
+    };
+    Kind kind = Kind::lambertian;
+    Color3 albedo = Color3(0, 0, 0);
+    double fuzz = 0;
+    double refraction_index = 1;
+    Color3 emission = Color3(0, 0, 0); //radiance of a diffuse light//
+};
 
 class Material{
     public:
@@ -14,45 +33,95 @@ class Material{
     virtual bool scatter(const Ray& ray_in, const Hit_record& rec, Color3& attenuation, Ray& scattered) const{
         return false;
     }
+
+    // Color of the surface itself, the albedo buffer the denoiser is guided by //
+    virtual Color3 base_color(const Hit_record&) const{
+        return Color3(1, 1, 1);
+    }
+
+    // Radiance the surface gives off towards the ray that hit it //
+    virtual Color3 emitted(const Hit_record&) const{
+        return Color3(0, 0, 0);
+    }
+
+    // Radiance from the front of the surface, what spheres and quads of the material are added to //
+    // the light list with //
+    virtual Color3 emission() const{
+        return Color3(0, 0, 0);
+    }
+
+    // For materials scattering by a smooth distribution: the BSDF times the cosine towards //
+    // direction, and the density scatter() picks direction with. False for mirrors and glass, //
+    // which light sampling cannot reach. //
+    virtual bool evaluate(const Ray&, const Hit_record&, const Vec3&, Color3&, double&) const{
+        return false;
+    }
 };
 
-class Lambertian : public Material{
+class Lambertian final : public Material{
     private:
     Color3 albedo;
 
     public:
     Lambertian(const Color3& albedo) : albedo(albedo) {};
 
+    Material_params params() const{
+        Material_params p;
+        p.kind = Material_params::Kind::lambertian;
+        p.albedo = albedo;
+        return p;
+    }
+
     bool scatter(const Ray& ray_in, const Hit_record& rec, Color3& attenuation, Ray& scattered)const override {
-        auto scatter_direction = rec.N + random_unit_vector();
-        if(scatter_direction.near_zero()){
-            scatter_direction = rec.N;
-        }
-        scattered = Ray(rec.P, scatter_direction);
+        // The distribution of rec.N + a unit vector, sampled directly, so it is never near zero //
+        scattered = Ray(rec.P, sample_cosine_direction(rec.N));
         attenuation = albedo;
         return true;
     }
 
+    Color3 base_color(const Hit_record&) const override{
+        return albedo;
+    }
+
+    // albedo / pi times the cosine, picked with the cosine / pi //
+    bool evaluate(const Ray&, const Hit_record& rec, const Vec3& direction, Color3& f_cos, double& pdf) const override{
+        double cosine = std::fmax(dot(unit_vector(direction), rec.N), 0.0);
+        pdf = cosine / pi;
+        f_cos = real(pdf) * albedo;
+        return true;
+    }
 };
 
-class Metal : public Material{
+class Metal final : public Material{
     private:
     Color3 albedo;
     double fuzz;
     public:
     Metal(const Color3& albedo, double fuzz) : albedo(albedo), fuzz(fuzz < 1 ? fuzz : 1) {};
 
+    Material_params params() const{
+        Material_params p;
+        p.kind = Material_params::Kind::metal;
+        p.albedo = albedo;
+        p.fuzz = fuzz;
+        return p;
+    }
+
     bool scatter(const Ray& ray_in, const Hit_record& rec, Color3& attenuation, Ray& scattered)const override{
         Vec3 reflected = reflect(ray_in.direction(), rec.N);
-        reflected = reflected + (fuzz * random_unit_vector());
+        reflected = reflected + (fuzz * sample_unit_vector());
         scattered = Ray(rec.P+(rec.N*0.001), reflected);
         attenuation = albedo;
         //return (dot(scattered.direction(), rec.N) > 0);
         return true;
     }
+
+    Color3 base_color(const Hit_record&) const override{
+        return albedo;
+    }
 };
 
-class Dielectric : public Material{
+class Dielectric final : public Material{
     private:
     double refraction_index;
     static double reflectance(double cosine, double refraction_index) {
@@ -64,6 +133,13 @@ class Dielectric : public Material{
     public:
     Dielectric(double refraction_index) : refraction_index(refraction_index) {};
 
+    Material_params params() const{
+        Material_params p;
+        p.kind = Material_params::Kind::dielectric;
+        p.refraction_index = refraction_index;
+        return p;
+    }
+
     bool scatter(const Ray& ray_in, const Hit_record& rec, Color3& attenuation, Ray& scattered)const override{
         attenuation = Color3(1.0, 1.0, 1.0);
         double ri;
@@ -77,7 +153,7 @@ class Dielectric : public Material{
         double cos_theta = std::fmin(dot(-unit_direction, rec.N), 1);
         double sin_theta = std::sqrt(1 - cos_theta*cos_theta);
         Vec3 direction;
-        if(ri * sin_theta > 1 || reflectance(cos_theta, ri) > random_double()){
+        if(ri * sin_theta > 1 || reflectance(cos_theta, ri) > sample_1d()){
             direction = reflect(unit_direction, rec.N);
         }else{
             direction = refract(unit_direction, rec.N, ri);
@@ -85,6 +161,73 @@ class Dielectric : public Material{
         scattered = Ray(rec.P, direction);
         return true;
     }
+
+    // Clear glass tints nothing, what shows through it is left to the color weight //
+    Color3 base_color(const Hit_record&) const override{
+        return Color3(1, 1, 1);
+    }
+};
+
+// Emits radiance from its front face and scatters nothing, paths end on it. Spheres and quads of //
+// it become area lights. //
+class Diffuse_light final : public Material{
+    private:
+    Color3 radiance;
+
+    public:
+    Diffuse_light(const Color3& radiance) : radiance(radiance) {};
+
+    Material_params params() const{
+        Material_params p;
+        p.kind = Material_params::Kind::diffuse_light;
+        p.emission = radiance;
+        return p;
+    }
+
+    bool scatter(const Ray&, const Hit_record&, Color3&, Ray&) const override{
+        return false;
+    }
+
+    Color3 emitted(const Hit_record& rec) const override{
+        return rec.front_face ? radiance : Color3(0, 0, 0);
+    }
+
+    Color3 emission() const override{
+        return radiance;
+    }
+};
+
+// The closed set of built-in materials, stored by value in a Static_scene //
+using Material_variant = std::variant<Lambertian, Metal, Dielectric, Diffuse_light>;
+
+inline Material_variant make_material(const Material_params& p){
+    switch(p.kind){
+        case Material_params::Kind::metal: return Metal(p.albedo, p.fuzz);
+        case Material_params::Kind::dielectric: return Dielectric(p.refraction_index);
+        case Material_params::Kind::diffuse_light: return Diffuse_light(p.emission);
+        default: return Lambertian(p.albedo);
+    }
+}
+
+// The materials of a scene in one array. Hit records carry an index into it instead of an owning //
+// pointer, so recording a hit never touches a reference count. //
+class Material_table{
+    private:
+    std::vector<shared_ptr<Material>> materials;
+
+    public:
+    Material_id add(shared_ptr<Material> mat){
+        materials.push_back(mat);
+        return Material_id(materials.size() - 1);
+    }
+
+    const Material& operator[](Material_id id) const{
+        return *materials[id];
+    }
+
+    size_t size() const{
+        return materials.size();
+    }
 };
 
 #endif
@@ -0,0 +1,61 @@
+#include "framebuffer.h"
+#include "image_io.h"
+#include "partial_image.h"
+#include <iostream>
+#include <string>
+#include <vector>
+
+// Adds up partial images written by rayTracer --partial into the final image. Partials may cover //
+// any tiles and sample ranges of one frame; every pixel gets the mean of all its samples. //
+
+int main(int argc, char* argv[]){
+    std::string output;
+    Image_format format = Image_format::ppm_ascii;
+    std::vector<std::string> inputs;
+    for(int k=1; k<argc; k++){
+        std::string option = argv[k];
+        if(option == "--output" && k+1 < argc){
+            output = argv[++k];
+            format = image_format_from_path(output, format);
+        }else if(option == "--format" && k+1 < argc && image_format_from_name(argv[k+1], format)){
+            k++;
+        }else if(!option.empty() && option[0] != '-'){
+            inputs.push_back(option);
+        }else{
+            inputs.clear();
+            break;
+        }
+    }
+    if(inputs.empty()){
+        std::cerr << "Usage: " << argv[0] << " [--output file] [--format p3|p6|png|pfm] partial...\n";
+        return 1;
+    }
+
+    Sample_accumulator total;
+    Partial_image partial;
+    for(size_t k=0; k<inputs.size(); k++){
+        if(!read_partial(inputs[k], partial)){
+            std::cerr << "Could not read the partial image " << inputs[k] << "\n";
+            return 1;
+        }
+        if(k == 0){
+            total.reset(partial.width, partial.height);
+        }
+        if(!total.add(partial)){
+            std::cerr << inputs[k] << " is " << partial.width << "x" << partial.height
+                      << ", the others " << total.width << "x" << total.height << "\n";
+            return 1;
+        }
+    }
+
+    Framebuffer image;
+    size_t missing = total.resolve(image);
+    if(missing > 0){
+        std::cerr << missing << " pixels have no samples and are left black\n";
+    }
+    if(!write_image(image, format, output)){
+        std::cerr << "Could not write the image to " << (output.empty() ? "standard output" : output) << "\n";
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,218 @@
+#ifndef OBJ_LOADER_H
+#define OBJ_LOADER_H
+
+#include "rtweekend.h"
+#include "triangle_mesh.h"
+#include "vec3.h"
+#include <charconv>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Wavefront OBJ reader for Triangle_mesh. The file is read in fixed size chunks and parsed line by //
+// line, so memory use is the mesh itself plus one chunk however large the file is. Reads v, vn and //
+// f (v, v/vt, v//vn and v/vt/vn corners, negative indices, polygons split into fans); texture //
+// coordinates, groups and materials are skipped, the whole mesh gets the Triangle_mesh's material. //
+
+class Obj_reader{
+    private:
+    Triangle_mesh& mesh;
+    std::vector<Point3> positions;
+    std::vector<Vec3> normals;
+    std::unordered_map<std::uint64_t, std::uint32_t> vertex_of; //mesh vertex of each used (position, normal) pair//
+    std::vector<std::uint32_t> polygon;
+
+    static void skip_space(const char*& at, const char* end){
+        while(at < end && (*at == ' ' || *at == '\t' || *at == '\r')){
+            at++;
+        }
+    }
+
+    static bool read_real(const char*& at, const char* end, real& value){
+        skip_space(at, end);
+        auto result = std::from_chars(at, end, value);
+        if(result.ec != std::errc()){
+            return false;
+        }
+        at = result.ptr;
+        return true;
+    }
+
+    static bool read_vector(const char*& at, const char* end, Vec3& v){
+        real x, y, z;
+        if(!read_real(at, end, x) || !read_real(at, end, y) || !read_real(at, end, z)){
+            return false;
+        }
+        v = Vec3(x, y, z);
+        return true;
+    }
+
+    // Turn a 1 based or negative (relative to the end) OBJ index into a 0 based one //
+    static bool resolve(long index, size_t count, std::uint32_t& out){
+        if(index > 0 && size_t(index) <= count){
+            out = std::uint32_t(index - 1);
+            return true;
+        }
+        if(index < 0 && size_t(-index) <= count){
+            out = std::uint32_t(count + index);
+            return true;
+        }
+        return false;
+    }
+
+    bool read_corner(const char*& at, const char* end, std::uint32_t& vertex){
+        long v = 0, n = 0;
+        auto result = std::from_chars(at, end, v);
+        if(result.ec != std::errc()){
+            return false;
+        }
+        at = result.ptr;
+        if(at < end && *at == '/'){
+            at++;
+            long vt = 0;
+            if(at < end && *at != '/'){
+                result = std::from_chars(at, end, vt);
+                if(result.ec != std::errc()){
+                    return false;
+                }
+                at = result.ptr;
+            }
+            if(at < end && *at == '/'){
+                at++;
+                result = std::from_chars(at, end, n);
+                if(result.ec != std::errc()){
+                    return false;
+                }
+                at = result.ptr;
+            }
+        }
+
+        std::uint32_t position, normal = 0;
+        if(!resolve(v, positions.size(), position)){
+            return false;
+        }
+        bool with_normal = n != 0;
+        if(with_normal && !resolve(n, normals.size(), normal)){
+            return false;
+        }
+        std::uint64_t key = (std::uint64_t(position) << 32) | (with_normal ? normal + 1 : 0);
+        auto found = vertex_of.find(key);
+        if(found != vertex_of.end()){
+            vertex = found->second;
+            return true;
+        }
+        vertex = with_normal ? mesh.add_vertex(positions[position], normals[normal]) : mesh.add_vertex(positions[position]);
+        vertex_of.emplace(key, vertex);
+        return true;
+    }
+
+    public:
+    Obj_reader(Triangle_mesh& mesh) : mesh(mesh) {}
+
+    // Parse one line without its newline, false on a malformed statement //
+    bool line(const char* at, const char* end){
+        skip_space(at, end);
+        if(at == end || *at == '#'){
+            return true;
+        }
+        const char* word = at;
+        while(at < end && *at != ' ' && *at != '\t'){
+            at++;
+        }
+        size_t length = size_t(at - word);
+        if(length == 1 && word[0] == 'v'){
+            Vec3 p;
+            if(!read_vector(at, end, p)){
+                return false;
+            }
+            positions.push_back(p);
+        }else if(length == 2 && word[0] == 'v' && word[1] == 'n'){
+            Vec3 n;
+            if(!read_vector(at, end, n)){
+                return false;
+            }
+            normals.push_back(n);
+        }else if(length == 1 && word[0] == 'f'){
+            polygon.clear();
+            while(true){
+                skip_space(at, end);
+                if(at == end || *at == '#'){
+                    break;
+                }
+                std::uint32_t vertex;
+                if(!read_corner(at, end, vertex)){
+                    return false;
+                }
+                polygon.push_back(vertex);
+            }
+            if(polygon.size() < 3){
+                return false;
+            }
+            for(size_t k=1; k+1<polygon.size(); k++){
+                mesh.add_triangle(polygon[0], polygon[k], polygon[k+1]);
+            }
+        }
+        return true;
+    }
+};
+
+// Read an OBJ file into mesh and build its hierarchy. Errors name the file and line. //
+inline bool load_obj(const std::string& path, Triangle_mesh& mesh, std::string& error){
+    std::FILE* file = std::fopen(path.c_str(), "rb");
+    if(!file){
+        error = "cannot read " + path;
+        return false;
+    }
+    Obj_reader reader(mesh);
+    std::vector<char> chunk(1 << 20);
+    size_t kept = 0; //bytes of an unfinished line carried over from the last chunk//
+    long line_number = 1;
+    bool ok = true;
+    while(ok){
+        if(kept == chunk.size()){
+            chunk.resize(chunk.size() * 2);
+        }
+        size_t read = std::fread(chunk.data() + kept, 1, chunk.size() - kept, file);
+        size_t available = kept + read;
+        bool last = read == 0;
+        const char* at = chunk.data();
+        const char* end = chunk.data() + available;
+        while(at < end){
+            const char* line_end = static_cast<const char*>(std::memchr(at, '\n', size_t(end - at)));
+            if(!line_end){
+                if(!last){
+                    break;
+                }
+                line_end = end;
+            }
+            if(!reader.line(at, line_end)){
+                ok = false;
+                break;
+            }
+            line_number++;
+            at = line_end < end ? line_end + 1 : end;
+        }
+        if(!ok || last){
+            break;
+        }
+        kept = size_t(end - at);
+        std::memmove(chunk.data(), at, kept);
+    }
+    bool read_error = std::ferror(file) != 0;
+    std::fclose(file);
+    if(!ok){
+        error = path + ":" + std::to_string(line_number) + ": bad statement";
+        return false;
+    }
+    if(read_error){
+        error = "cannot read " + path;
+        return false;
+    }
+    mesh.build();
+    return true;
+}
+
+#endif
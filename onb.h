@@ -0,0 +1,29 @@
+#ifndef ONB_H
+#define ONB_H
+
+#include "rtweekend.h"
+#include "vec3.h"
+#include <cmath>
+
+// Orthonormal basis with w along a unit normal, built without a branch on which axis the normal //
+// is closest to (Duff et al. 2017, "Building an Orthonormal Basis, Revisited") //
+class Onb{
+    public:
+    Vec3 u, v, w;
+
+    explicit Onb(const Vec3& n){
+        real sign = std::copysign(real(1), n[2]);
+        real a = -1 / (sign + n[2]);
+        real b = n[0] * n[1] * a;
+        u = Vec3(1 + sign * n[0] * n[0] * a, sign * b, -sign * n[0]);
+        v = Vec3(b, sign + n[1] * n[1] * a, -n[1]);
+        w = n;
+    }
+
+    // A vector given in the basis' coordinates, in world space //
+    Vec3 to_world(const Vec3& local) const{
+        return local[0] * u + local[1] * v + local[2] * w;
+    }
+};
+
+#endif
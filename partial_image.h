@@ -0,0 +1,233 @@
+#ifndef PARTIAL_IMAGE_H
+#define PARTIAL_IMAGE_H
+
+#include "color.h"
+#include "framebuffer.h"
+#include "rtweekend.h"
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+// Pieces of a frame rendered separately, e.g. by farm workers, and added up afterwards. A job is a //
+// rectangle of pixels and a range of sample indices; since every (pixel, sample) has its own random //
+// stream, jobs over any split of the image and of the samples add up to the same picture. //
+
+struct Render_job{
+    int x0 = 0, y0 = 0, x1 = 0, y1 = 0; //pixels [x0, x1) x [y0, y1)//
+    int first_sample = 0;
+    int sample_count = 0;
+};
+
+// Split a width x height frame of samples_per_pixel samples into square tiles of tile_size pixels, //
+// each tile cut into sample_splits sample ranges //
+inline std::vector<Render_job> split_frame(int width, int height, int samples_per_pixel, int tile_size, int sample_splits){
+    std::vector<Render_job> jobs;
+    tile_size = std::max(tile_size, 1);
+    sample_splits = std::max(1, std::min(sample_splits, samples_per_pixel));
+    for(int y=0; y<height; y += tile_size){
+        for(int x=0; x<width; x += tile_size){
+            for(int s=0; s<sample_splits; s++){
+                Render_job job;
+                job.x0 = x;
+                job.y0 = y;
+                job.x1 = std::min(x + tile_size, width);
+                job.y1 = std::min(y + tile_size, height);
+                job.first_sample = int(std::int64_t(samples_per_pixel) * s / sample_splits);
+                job.sample_count = int(std::int64_t(samples_per_pixel) * (s+1) / sample_splits) - job.first_sample;
+                jobs.push_back(job);
+            }
+        }
+    }
+    return jobs;
+}
+
+// Unnormalized sample sums and sample counts of the pixels of one job, in a frame of width x height //
+class Partial_image{
+    public:
+    int width = 0, height = 0;
+    Render_job job;
+    std::vector<double> sum; //3 per pixel of the region, row by row//
+    std::vector<std::uint32_t> count;
+
+    // Size the buffers for job, clamped to the frame //
+    void reset(int frame_width, int frame_height, const Render_job& j){
+        width = frame_width;
+        height = frame_height;
+        job = j;
+        job.x0 = std::clamp(job.x0, 0, width);
+        job.x1 = std::clamp(job.x1, job.x0, width);
+        job.y0 = std::clamp(job.y0, 0, height);
+        job.y1 = std::clamp(job.y1, job.y0, height);
+        size_t pixels = size_t(job.x1 - job.x0) * (job.y1 - job.y0);
+        sum.assign(3 * pixels, 0.0);
+        count.assign(pixels, 0);
+    }
+
+    size_t index(int i, int j) const{
+        return size_t(j - job.y0) * (job.x1 - job.x0) + (i - job.x0);
+    }
+
+    void set(int i, int j, const Color3& samples_sum, std::uint32_t samples){
+        size_t k = index(i, j);
+        for(int c=0; c<3; c++){
+            sum[3*k + c] = samples_sum[c];
+        }
+        count[k] = samples;
+    }
+};
+
+// Binary form of a Partial_image: a header, the sums and the counts, in host byte order //
+static const char partial_image_magic[8] = {'R', 'T', 'P', 'A', 'R', 'T', 0, 0};
+static const std::uint32_t partial_image_byte_order = 0x01020304;
+
+struct Partial_image_header{
+    char magic[8];
+    std::uint32_t byte_order;
+    std::int32_t width, height;
+    std::int32_t x0, y0, x1, y1;
+    std::int32_t first_sample, sample_count;
+    std::uint32_t pad;
+};
+
+inline std::vector<unsigned char> encode_partial(const Partial_image& partial){
+    Partial_image_header header = {};
+    std::memcpy(header.magic, partial_image_magic, sizeof(header.magic));
+    header.byte_order = partial_image_byte_order;
+    header.width = partial.width;
+    header.height = partial.height;
+    header.x0 = partial.job.x0;
+    header.y0 = partial.job.y0;
+    header.x1 = partial.job.x1;
+    header.y1 = partial.job.y1;
+    header.first_sample = partial.job.first_sample;
+    header.sample_count = partial.job.sample_count;
+
+    size_t sums = partial.sum.size() * sizeof(double);
+    size_t counts = partial.count.size() * sizeof(std::uint32_t);
+    std::vector<unsigned char> out(sizeof(header) + sums + counts);
+    std::memcpy(out.data(), &header, sizeof(header));
+    if(sums > 0){
+        std::memcpy(out.data() + sizeof(header), partial.sum.data(), sums);
+        std::memcpy(out.data() + sizeof(header) + sums, partial.count.data(), counts);
+    }
+    return out;
+}
+
+// Size of the encoded partial starting with header, 0 when the header is not valid //
+inline size_t encoded_partial_size(const Partial_image_header& header){
+    if(std::memcmp(header.magic, partial_image_magic, sizeof(header.magic)) != 0
+       || header.byte_order != partial_image_byte_order
+       || header.width < 0 || header.height < 0
+       || header.x0 < 0 || header.x1 < header.x0 || header.x1 > header.width
+       || header.y0 < 0 || header.y1 < header.y0 || header.y1 > header.height){
+        return 0;
+    }
+    size_t pixels = size_t(header.x1 - header.x0) * size_t(header.y1 - header.y0);
+    return sizeof(header) + pixels * (3 * sizeof(double) + sizeof(std::uint32_t));
+}
+
+inline bool decode_partial(const unsigned char* data, size_t size, Partial_image& partial){
+    Partial_image_header header;
+    if(size < sizeof(header)){
+        return false;
+    }
+    std::memcpy(&header, data, sizeof(header));
+    if(encoded_partial_size(header) != size){
+        return false;
+    }
+    Render_job job;
+    job.x0 = header.x0;
+    job.y0 = header.y0;
+    job.x1 = header.x1;
+    job.y1 = header.y1;
+    job.first_sample = header.first_sample;
+    job.sample_count = header.sample_count;
+    partial.reset(header.width, header.height, job);
+    size_t sums = partial.sum.size() * sizeof(double);
+    if(sums > 0){
+        std::memcpy(partial.sum.data(), data + sizeof(header), sums);
+        std::memcpy(partial.count.data(), data + sizeof(header) + sums, partial.count.size() * sizeof(std::uint32_t));
+    }
+    return true;
+}
+
+inline bool write_partial(const Partial_image& partial, const std::string& path){
+    auto bytes = encode_partial(partial);
+    std::FILE* file = std::fopen(path.c_str(), "wb");
+    if(!file){
+        return false;
+    }
+    bool ok = std::fwrite(bytes.data(), 1, bytes.size(), file) == bytes.size();
+    return std::fclose(file) == 0 && ok;
+}
+
+inline bool read_partial(const std::string& path, Partial_image& partial){
+    std::FILE* file = std::fopen(path.c_str(), "rb");
+    if(!file){
+        return false;
+    }
+    std::vector<unsigned char> bytes;
+    unsigned char chunk[65536];
+    size_t read;
+    while((read = std::fread(chunk, 1, sizeof(chunk), file)) > 0){
+        bytes.insert(bytes.end(), chunk, chunk + read);
+    }
+    bool ok = !std::ferror(file);
+    std::fclose(file);
+    return ok && decode_partial(bytes.data(), bytes.size(), partial);
+}
+
+// Adds partials of one frame together, in any order and with any sample counts per pixel //
+class Sample_accumulator{
+    public:
+    int width = 0, height = 0;
+    std::vector<double> sum;
+    std::vector<std::uint32_t> count;
+
+    void reset(int w, int h){
+        width = w;
+        height = h;
+        sum.assign(3 * size_t(w) * h, 0.0);
+        count.assign(size_t(w) * h, 0);
+    }
+
+    // False when the partial belongs to a frame of another size //
+    bool add(const Partial_image& partial){
+        if(partial.width != width || partial.height != height){
+            return false;
+        }
+        const Render_job& job = partial.job;
+        for(int j=job.y0; j<job.y1; j++){
+            for(int i=job.x0; i<job.x1; i++){
+                size_t from = partial.index(i, j);
+                size_t to = size_t(j) * width + i;
+                for(int c=0; c<3; c++){
+                    sum[3*to + c] += partial.sum[3*from + c];
+                }
+                count[to] += partial.count[from];
+            }
+        }
+        return true;
+    }
+
+    // Mean of each pixel, black where no samples arrived; returns the number of such pixels //
+    size_t resolve(Framebuffer& image) const{
+        image.resize(width, height);
+        size_t missing = 0;
+        for(size_t k=0; k<count.size(); k++){
+            if(count[k] == 0){
+                missing++;
+                continue;
+            }
+            // Same operation order as Camera's average, so a single partial per pixel reproduces it //
+            Color3 total(sum[3*k], sum[3*k + 1], sum[3*k + 2]);
+            image.pixels[k] = (1.0 / count[k]) * total;
+        }
+        return missing;
+    }
+};
+
+#endif
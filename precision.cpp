@@ -0,0 +1,112 @@
+#include "bvh.h"
+#include "camera.h"
+#include "color.h"
+#include "framebuffer.h"
+#include "image_io.h"
+#include "scene.h"
+#include "scenes.h"
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+// Renders the rayTracing.cpp scene at a fixed seed and reports how long it took. The same source is //
+// built once with double and once with RT_SINGLE_PRECISION; given the other build's image with //
+// --reference it also reports how far the two renders are apart. //
+
+#ifdef RT_SINGLE_PRECISION
+static const char* precision_name = "float";
+#else
+static const char* precision_name = "double";
+#endif
+
+// Print the error of image against reference, on linear values and on the written 8 bit values //
+static bool report_error(const Framebuffer& image, const Framebuffer& reference){
+    if(image.width != reference.width || image.height != reference.height){
+        std::cerr << "The reference is " << reference.width << "x" << reference.height
+                  << ", the render " << image.width << "x" << image.height << "\n";
+        return false;
+    }
+    double squared_sum = 0;
+    double max_error = 0;
+    long long byte_sum = 0;
+    int max_byte_error = 0;
+    for(size_t k=0; k<image.pixels.size(); k++){
+        unsigned char a[3], b[3];
+        color_to_bytes(image.pixels[k], a);
+        color_to_bytes(reference.pixels[k], b);
+        for(int c=0; c<3; c++){
+            double error = std::fabs(double(image.pixels[k][c]) - double(reference.pixels[k][c]));
+            squared_sum += error * error;
+            max_error = std::fmax(max_error, error);
+            int byte_error = std::abs(int(a[c]) - int(b[c]));
+            byte_sum += byte_error;
+            max_byte_error = std::max(max_byte_error, byte_error);
+        }
+    }
+    double values = 3.0 * image.pixels.size();
+    std::cout << "linear RMSE " << std::sqrt(squared_sum / values) << ", max " << max_error
+              << "; 8 bit mean " << byte_sum / values << ", max " << max_byte_error << "\n";
+    return true;
+}
+
+int main(int argc, char* argv[]){
+    int width = 480;
+    int samples = 16;
+    std::string output = std::string("precision_") + precision_name + ".pfm";
+    std::string reference_path;
+    for(int k=1; k<argc; k++){
+        std::string option = argv[k];
+        if(option == "--width" && k+1 < argc){
+            width = std::atoi(argv[++k]);
+        }else if(option == "--spp" && k+1 < argc){
+            samples = std::atoi(argv[++k]);
+        }else if(option == "--output" && k+1 < argc){
+            output = argv[++k];
+        }else if(option == "--reference" && k+1 < argc){
+            reference_path = argv[++k];
+        }else{
+            std::cerr << "Usage: " << argv[0] << " [--width n] [--spp n] [--output file.pfm] [--reference file.pfm]\n";
+            return 1;
+        }
+    }
+
+    seed_random(0, 0);
+    Scene scene = random_spheres_scene();
+    scene.world = Hittable_list(make_shared<Linear_bvh>(scene.world));
+
+    Camera cam;
+    cam.aspect_ratio = 16.0 / 9.0;
+    cam.image_width = width;
+    cam.samples_per_pixel = samples;
+    cam.vfov = 7;
+    cam.lookfrom = Point3(20,1,3);
+    cam.lookat = Point3(0,0,0);
+    cam.vup = Vec3(0,1,0);
+    cam.defocus_angle = 0.6;
+    cam.focus_dist = 15.0;
+    cam.packet_tracing = true;
+    cam.quiet = true;
+
+    auto start = std::chrono::steady_clock::now();
+    cam.render_image(scene);
+    std::chrono::duration<double> seconds = std::chrono::steady_clock::now() - start;
+    if(!write_image(cam.image(), Image_format::pfm, output)){
+        std::cerr << "Could not write " << output << "\n";
+        return 1;
+    }
+
+    std::cout << precision_name << " (Vec3 " << sizeof(Vec3) << " bytes): " << width << " wide, "
+              << samples << " spp in " << seconds.count() << " s\n";
+    if(reference_path.empty()){
+        return 0;
+    }
+    Framebuffer reference;
+    if(!read_pfm(reference_path, reference)){
+        std::cerr << "Could not read " << reference_path << "\n";
+        return 1;
+    }
+    std::cout << precision_name << " against " << reference_path << ": ";
+    return report_error(cam.image(), reference) ? 0 : 1;
+}
@@ -0,0 +1,201 @@
+#ifndef PREVIEW_H
+#define PREVIEW_H
+
+#include "camera.h"
+#include "framebuffer.h"
+#include "image_io.h"
+#include "partial_image.h"
+#include "scene_io.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Interactive preview: a long running process holding the scene, which reads commands on its //
+// standard input and streams ever better frames of the current view on its standard output. //
+// Commands, one per line: //
+//   camera <field> <values>     as in scene files, e.g. camera lookfrom 1 2 3; restarts the refinement //
+//   restart                     start refining the current view again //
+//   stop                        cancel the work in flight and wait for the next command //
+//   quit                        end, as does the end of the input //
+// Every command cancels the work in flight at once: render threads skip the rows they have not //
+// started, so a new view shows up within about a row of samples. A view first comes at 1/8, 1/4 //
+// and 1/2 of the width with one sample, then at full size with doubling sample counts until //
+// samples_per_pixel. Each frame is a line //
+//   frame <view> <width> <height> <samples> <bytes> //
+// followed by that many bytes of the image encoded in the camera's output format. view counts the //
+// restarts, so a client can drop frames of views it has moved away from. Rejected commands get //
+// "error <message>" lines instead. A socket works as well through e.g. socat. //
+
+struct Preview_options{
+    int first_scale = 8; //the first frame of a view is this many times narrower//
+    bool quiet = false; //no timing per frame on std::clog//
+};
+
+// Command lines read on a thread of their own, so they can cancel a render while it runs //
+class Preview_commands{
+    private:
+    std::mutex lock;
+    std::condition_variable arrived;
+    std::vector<std::string> lines;
+
+    public:
+    std::atomic<bool> cancel{false};
+
+    void push(const std::string& line){
+        std::lock_guard<std::mutex> guard(lock);
+        lines.push_back(line);
+        cancel.store(true, std::memory_order_relaxed);
+        arrived.notify_one();
+    }
+
+    // The lines received so far, waiting for one first when wait is set. Clears the cancel flag //
+    // together with them, so a line arriving later always cancels the next render. //
+    std::vector<std::string> take(bool wait){
+        std::unique_lock<std::mutex> guard(lock);
+        if(wait){
+            arrived.wait(guard, [&]{ return !lines.empty(); });
+        }
+        std::vector<std::string> taken;
+        taken.swap(lines);
+        cancel.store(false, std::memory_order_relaxed);
+        return taken;
+    }
+};
+
+inline bool write_preview_frame(std::FILE* out, int view, const Framebuffer& image, int samples, Image_format format){
+    auto bytes = encode_image(image, format);
+    std::string header = "frame " + std::to_string(view) + " " + std::to_string(image.width) + " "
+                       + std::to_string(image.height) + " " + std::to_string(samples) + " "
+                       + std::to_string(bytes.size()) + "\n";
+    return std::fwrite(header.data(), 1, header.size(), out) == header.size()
+        && std::fwrite(bytes.data(), 1, bytes.size(), out) == bytes.size()
+        && std::fflush(out) == 0;
+}
+
+// Serve the preview protocol on in and out until quit, 0 on success //
+template <typename Scene_type>
+int run_preview(const Scene_type& scene, Camera& cam, std::FILE* in, std::FILE* out,
+                const Preview_options& options = Preview_options()){
+    // Shared with the reader, which may outlive this call when the output breaks //
+    auto commands = make_shared<Preview_commands>();
+    std::thread reader([commands, in]{
+        char line[1024];
+        while(std::fgets(line, sizeof(line), in)){
+            commands->push(line);
+            if(std::strncmp(line, "quit", 4) == 0){
+                return;
+            }
+        }
+        commands->push("quit");
+    });
+
+    cam.cancel = &commands->cancel;
+    cam.quiet = true;
+    Sample_accumulator total;
+    Partial_image partial;
+    Framebuffer image;
+    int view = 0;
+    int scale = std::max(options.first_scale, 1);
+    int samples = 0; //samples per pixel so far at full size//
+    bool refining = true;
+    bool quit = false;
+    bool failed = false;
+    while(!quit && !failed){
+        bool restart = false;
+        for(const auto& text : commands->take(!refining)){
+            Scene_line line;
+            if(!line.split(text.data(), text.data() + text.size()) || line.count == 0){
+                continue;
+            }
+            if(line.is(0, "quit")){
+                quit = true;
+            }else if(line.is(0, "stop")){
+                refining = false;
+            }else if(line.is(0, "restart")){
+                restart = true;
+            }else{
+                bool camera = line.is(0, "camera");
+                if(camera && parse_camera_line(line, cam)){
+                    restart = true;
+                    continue;
+                }
+                std::string error = camera ? "error bad camera setting\n" : "error unknown command " + line.text(0) + "\n";
+                std::fwrite(error.data(), 1, error.size(), out);
+                std::fflush(out);
+            }
+        }
+        if(quit){
+            break;
+        }
+        if(restart){
+            view++;
+            scale = std::max(options.first_scale, 1);
+            samples = 0;
+            refining = true;
+        }
+        if(!refining){
+            continue;
+        }
+
+        auto start = std::chrono::steady_clock::now();
+        int full_width = cam.image_width;
+        Render_job job;
+        if(scale > 1){
+            // A quick look at a fraction of the size, replaced by the next frame //
+            cam.image_width = std::max(full_width / scale, 1);
+            job.x1 = cam.image_width;
+            job.y1 = cam.output_height();
+            job.sample_count = 1;
+            total.reset(job.x1, job.y1);
+        }else{
+            if(samples == 0){
+                total.reset(cam.image_width, cam.output_height());
+            }
+            job.x1 = cam.image_width;
+            job.y1 = cam.output_height();
+            job.first_sample = samples;
+            job.sample_count = std::min(std::max(samples, 1), cam.samples_per_pixel - samples);
+        }
+        cam.render_region(scene, job, partial);
+        cam.image_width = full_width;
+        if(commands->cancel.load(std::memory_order_relaxed)){
+            // Partly rendered, the commands decide what comes next //
+            continue;
+        }
+
+        total.add(partial);
+        total.resolve(image);
+        int frame_samples = scale > 1 ? 1 : samples + job.sample_count;
+        failed = !write_preview_frame(out, view, image, frame_samples, cam.output_format);
+        if(!options.quiet){
+            std::chrono::duration<double, std::milli> ms = std::chrono::steady_clock::now() - start;
+            std::clog << "View " << view << ": " << image.width << "x" << image.height << ", "
+                      << frame_samples << " samples in " << ms.count() << " ms\n";
+        }
+        if(scale > 1){
+            scale /= 2;
+        }else{
+            samples = frame_samples;
+            refining = samples < cam.samples_per_pixel;
+        }
+    }
+
+    cam.cancel = nullptr;
+    if(failed){
+        // Nobody reads the frames any more; the reader ends with the input //
+        reader.detach();
+        return 1;
+    }
+    reader.join();
+    return 0;
+}
+
+#endif
@@ -0,0 +1,69 @@
+#ifndef QUAD_H
+#define QUAD_H
+
+#include "aabb.h"
+#include "hittable.h"
+#include "interval.h"
+#include "ray.h"
+#include "rtweekend.h"
+#include "vec3.h"
+#include <cmath>
+
+// Parallelogram with corner Q and edges u and v, so Q + a*u + b*v for a, b in [0, 1]. Its front //
+// faces along u x v, which is the side an area light on it shines to. //
+class Quad final : public Hittable{
+    private:
+    Point3 Q;
+    Vec3 u, v;
+    Vec3 w; //n / (n . n) for n = u x v, turns a point in the plane into a and b//
+    Vec3 normal;
+    real D; //plane offset, normal . Q//
+    Material_id mat;
+    Aabb bbox;
+
+    public:
+    Quad(const Point3& Q, const Vec3& u, const Vec3& v, Material_id mat) : Q(Q), u(u), v(v), mat(mat) {
+        Vec3 n = cross(u, v);
+        normal = unit_vector(n);
+        D = dot(normal, Q);
+        w = n / dot(n, n);
+        bbox = Aabb(Aabb(Q, Q + u + v), Aabb(Q + u, Q + v));
+    }
+
+    bool hit(const Ray& r, Interval ray_t, Hit_record& rec) const override{
+        auto denom = dot(normal, r.direction());
+        // Rays parallel to the plane miss it //
+        if(std::fabs(denom) < real(1e-8)){
+            return false;
+        }
+        auto t = (D - dot(normal, r.origin())) / denom;
+        if(!ray_t.contains(t)){
+            return false;
+        }
+
+        // Plane coordinates of the hit in the u, v frame //
+        Point3 P = r.at(t);
+        Vec3 planar = P - Q;
+        auto a = dot(w, cross(planar, v));
+        auto b = dot(w, cross(u, planar));
+        if(a < 0 || a > 1 || b < 0 || b > 1){
+            return false;
+        }
+
+        rec.t = t;
+        rec.P = P;
+        rec.set_face_normal(r, normal);
+        rec.mat = mat;
+        return true;
+    }
+
+    bool uses_marked_material(const std::vector<char>& marked) const override{
+        return is_marked(marked, mat);
+    }
+
+    Aabb bounding_box() const override{
+        return bbox;
+    }
+};
+
+#endif
@@ -24,7 +24,7 @@ class Ray{
       return dir;
   }
 
-  Point3 at(double t) const{
+  Point3 at(real t) const{
       return orig + dir*t;
   }
 
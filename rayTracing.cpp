@@ -1,53 +1,164 @@
+#include "animation.h"
+#include "bvh.h"
+#include "farm.h"
 #include "hittable_list.h"
+#include "partial_image.h"
+#include "preview.h"
+#include "scene_io.h"
+#include "scenes.h"
+#include "static_scene.h"
+#include "stats.h"
 #include "sphere.h"
 #include "camera.h"
+#include <chrono>
 #include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
 #include "material.h"
 #include "vec3.h"
 
-int main(){
-    // Create the scene world //
-    Hittable_list world;
-    auto ground_material = make_shared<Lambertian>(Color3(0.5, 0.5, 0.5));
-    world.add(make_shared<Sphere>(Point3(0,-1000,0), 1000, ground_material));
-
-    for (int a = -11; a < 11; a++) {
-        for (int b = -11; b < 11; b++) {
-            auto choose_mat = random_double();
-            Point3 center(a + 0.9*random_double(), 0.18, b + 0.9*random_double());
-
-            if ((center - Point3(4, 0.2, 0)).length() > 0.9) {
-                shared_ptr<Material> sphere_material;
-
-                if (choose_mat < 0.7) {
-                    // diffuse
-                    auto albedo = Color3::random() * Color3::random();
-                    sphere_material = make_shared<Lambertian>(albedo);
-                    world.add(make_shared<Sphere>(center, 0.2, sphere_material));
-                } else if (choose_mat < 0.95) {
-                    // metal
-                    auto albedo = Color3::random(0.5, 1);
-                    auto fuzz = random_double(0, 0.5);
-                    sphere_material = make_shared<Metal>(albedo, fuzz);
-                    world.add(make_shared<Sphere>(center, 0.2, sphere_material));
-                } else {
-                    // glass
-                    sphere_material = make_shared<Dielectric>(1.5);
-                    world.add(make_shared<Sphere>(center, 0.2, sphere_material));
-                }
-            }
+// How a loaded scene is used: rendered here, as an animated sequence, as an interactive preview, //
+// by a farm of worker processes, as one farm worker, or as a single job written to a partial //
+// image for rt_merge //
+struct Run_options{
+    int farm_workers = 0;
+    Farm_options farm;
+    bool worker = false;
+    std::string partial_path;
+    Render_job job;
+    bool full_region = true;
+    bool all_samples = true;
+    std::string sequence_pattern;
+    int frames = 0; //overrides the scene's frame count when set//
+    Animation animation; //from the scene file, a turntable when it has none//
+    bool preview = false;
+    std::string stats_path; //JSON statistics report written after rendering//
+    std::string trace_path; //Chrome trace of the scoped timers//
+    std::string aov_prefix; //albedo, normal and depth buffers written to <prefix>_<name>.pfm//
+    int max_depth = 0; //overrides the scene's camera max_depth when set//
+    int min_bounces = -1; //overrides the scene's camera min_bounces when set//
+};
+
+// Command line camera settings, applied once the scene file has set its own //
+void apply_camera_options(const Run_options& options, Camera& cam){
+    if(options.max_depth > 0){
+        cam.max_depth = options.max_depth;
+    }
+    if(options.min_bounces >= 0){
+        cam.min_bounces = options.min_bounces;
+    }
+}
+
+template <typename Scene_type>
+int render_with(Scene_type& scene, Camera& cam, const Run_options& options){
+    if(options.worker){
+        cam.quiet = true;
+        return run_worker(scene, cam, stdin, stdout);
+    }
+
+    if(!options.partial_path.empty()){
+        Render_job job = options.job;
+        if(options.full_region){
+            job.x0 = job.y0 = 0;
+            job.x1 = cam.image_width;
+            job.y1 = cam.output_height();
+        }
+        if(options.all_samples){
+            job.first_sample = 0;
+            job.sample_count = cam.samples_per_pixel;
+        }
+        Partial_image partial;
+        cam.render_region(scene, job, partial);
+        if(!write_partial(partial, options.partial_path)){
+            std::cerr << "Could not write " << options.partial_path << "\n";
+            return 1;
+        }
+        return 0;
+    }
+
+    if(options.preview){
+        // ASCII frames would only slow the stream down //
+        if(cam.output_format == Image_format::ppm_ascii){
+            cam.output_format = Image_format::ppm_binary;
         }
+        Preview_options preview;
+        preview.quiet = cam.quiet;
+        return run_preview(scene, cam, stdin, stdout, preview);
     }
 
-    /*auto material1 = make_shared<Dielectric>(1.5);
-    world.add(make_shared<Sphere>(Point3(0, 1, 0), 1.0, material1));
-    */
-    auto material2 = make_shared<Lambertian>(Color3(0.4, 0.2, 0.1));
-    world.add(make_shared<Sphere>(Point3(-4, 1, 0), 1.0, material2));
+    if(!options.sequence_pattern.empty()){
+        Animation animation = options.animation;
+        int frames = options.frames > 0 ? options.frames : animation.frames > 0 ? animation.frames : 24;
+        if(animation.empty()){
+            animation = turntable(cam, frames);
+        }
+        animation.frames = frames;
+        std::string error;
+        if(!render_sequence(scene, cam, animation, options.sequence_pattern, error)){
+            std::cerr << "Sequence render failed: " << error << "\n";
+            return 1;
+        }
+        return 0;
+    }
+
+    if(options.farm_workers > 0){
+        auto start = std::chrono::steady_clock::now();
+        Sample_accumulator result;
+        std::string error;
+        if(!run_farm(options.farm, cam.image_width, cam.output_height(), cam.samples_per_pixel, result, error)){
+            std::cerr << "Farm render failed: " << error << "\n";
+            return 1;
+        }
+        Framebuffer image;
+        result.resolve(image);
+        if(!write_image(image, cam.output_format, cam.output_path)){
+            std::cerr << "Could not write the image to " << (cam.output_path.empty() ? "standard output" : cam.output_path) << "\n";
+            return 1;
+        }
+        if(!cam.quiet){
+            std::chrono::duration<double> seconds = std::chrono::steady_clock::now() - start;
+            std::clog << "Farm render time: " << seconds.count() << " s on " << options.farm_workers << " workers\n";
+        }
+        return 0;
+    }
 
-    auto material3 = make_shared<Metal>(Color3(0.7, 0.6, 0.5), 0.0);
-    world.add(make_shared<Sphere>(Point3(4, 1, 0), 1.0, material3));
+    cam.render(scene);
+    if(!options.aov_prefix.empty()){
+        Framebuffer albedo, normal, depth;
+        cam.aovs().to_images(albedo, normal, depth);
+        const Framebuffer* images[3] = {&albedo, &normal, &depth};
+        const char* names[3] = {"albedo", "normal", "depth"};
+        for(int k=0; k<3; k++){
+            std::string path = options.aov_prefix + "_" + names[k] + ".pfm";
+            if(!write_image(*images[k], Image_format::pfm, path)){
+                std::cerr << "Could not write " << path << "\n";
+                return 1;
+            }
+        }
+    }
+    return 0;
+}
+
+template <typename Scene_type>
+int run(Scene_type& scene, Camera& cam, const Run_options& options){
+    apply_camera_options(options, cam);
+    int result = render_with(scene, cam, options);
+    std::string error;
+    if(!options.stats_path.empty() && !write_stats_report(options.stats_path, material_type_names(scene), error)){
+        std::cerr << error << "\n";
+        result = 1;
+    }
+    if(!options.trace_path.empty() && !write_stats_trace(options.trace_path, error)){
+        std::cerr << error << "\n";
+        result = 1;
+    }
+    return result;
+}
 
+int main(int argc, char* argv[]){
     // Create camera object //
     Camera cam;
 
@@ -62,5 +173,189 @@ int main(){
 
         cam.defocus_angle = 0.6;
         cam.focus_dist    = 15.0;
-    cam.render(world);
+
+    cam.packet_tracing = true;
+    cam.sampler = Sampler_type::sobol;
+
+    // Options: --output <file> (format from the extension), --format p3|p6|png|pfm, //
+    // --dispatch virtual|static to pick the scene representation, --scene <file> to render a //
+    // text or binary scene file instead of the built-in one, and --write-scene <file> to save //
+    // the scene (binary for .rtsb, text otherwise) with the camera settings and exit. //
+    // --seed n and --threads n set the Camera fields of the same name, --sampler random|stratified| //
+    // halton|sobol picks how the samples of a pixel are spread (sampler.h, sobol by default). //
+    // --max-depth n caps the rays of a path, --min-bounces n sets the bounces before Russian //
+    // roulette may end it (max depth or more turns roulette off); both win over the scene file's. //
+    // Farm: --farm n renders on n local worker processes (--farm-tile size, --farm-splits sample //
+    // ranges per tile); --worker serves jobs on standard input; --partial file renders one job, //
+    // --region x0 y0 x1 y1 and --sample-range first count, into a file for rt_merge //
+    // Sequences: --sequence pattern renders the scene's animation, or a turntable around lookat //
+    // when it has none, to pattern with its run of '#' numbering the frames; --frames n sets the //
+    // frame count. --preview serves the interactive preview protocol of preview.h on standard //
+    // input and output. //
+    // Builds with RT_ENABLE_STATS take --stats file.json for counters and timer totals and //
+    // --trace file.json for a Chrome trace of the timers. //
+    // --denoise filters the image guided by first hit albedo, normal and depth buffers, --aov //
+    // prefix writes those buffers to prefix_albedo.pfm, prefix_normal.pfm and prefix_depth.pfm. //
+    bool static_dispatch = false;
+    std::string scene_path;
+    std::string write_path;
+    Run_options run_options;
+    int threads = 0;
+    for(int k=1; k<argc; k++){
+        std::string option = argv[k];
+        if(option == "--output" && k+1 < argc){
+            cam.output_path = argv[++k];
+            cam.output_format = image_format_from_path(cam.output_path, cam.output_format);
+        }else if(option == "--format" && k+1 < argc && image_format_from_name(argv[k+1], cam.output_format)){
+            k++;
+        }else if(option == "--dispatch" && k+1 < argc && (std::string(argv[k+1]) == "virtual" || std::string(argv[k+1]) == "static")){
+            static_dispatch = std::string(argv[++k]) == "static";
+        }else if(option == "--scene" && k+1 < argc){
+            scene_path = argv[++k];
+        }else if(option == "--write-scene" && k+1 < argc){
+            write_path = argv[++k];
+        }else if(option == "--seed" && k+1 < argc){
+            cam.seed = std::strtoull(argv[++k], nullptr, 10);
+        }else if(option == "--sampler" && k+1 < argc && sampler_type_from_name(argv[k+1], cam.sampler)){
+            k++;
+        }else if(option == "--max-depth" && k+1 < argc){
+            run_options.max_depth = std::atoi(argv[++k]);
+        }else if(option == "--min-bounces" && k+1 < argc){
+            run_options.min_bounces = std::atoi(argv[++k]);
+        }else if(option == "--threads" && k+1 < argc){
+            threads = std::atoi(argv[++k]);
+            cam.num_threads = threads;
+        }else if(option == "--farm" && k+1 < argc){
+            run_options.farm_workers = std::atoi(argv[++k]);
+        }else if(option == "--farm-tile" && k+1 < argc){
+            run_options.farm.tile_size = std::atoi(argv[++k]);
+        }else if(option == "--farm-splits" && k+1 < argc){
+            run_options.farm.sample_splits = std::atoi(argv[++k]);
+        }else if(option == "--worker"){
+            run_options.worker = true;
+        }else if(option == "--partial" && k+1 < argc){
+            run_options.partial_path = argv[++k];
+        }else if(option == "--region" && k+4 < argc){
+            run_options.job.x0 = std::atoi(argv[++k]);
+            run_options.job.y0 = std::atoi(argv[++k]);
+            run_options.job.x1 = std::atoi(argv[++k]);
+            run_options.job.y1 = std::atoi(argv[++k]);
+            run_options.full_region = false;
+        }else if(option == "--sample-range" && k+2 < argc){
+            run_options.job.first_sample = std::atoi(argv[++k]);
+            run_options.job.sample_count = std::atoi(argv[++k]);
+            run_options.all_samples = false;
+        }else if(option == "--sequence" && k+1 < argc){
+            run_options.sequence_pattern = argv[++k];
+            cam.output_format = image_format_from_path(run_options.sequence_pattern, cam.output_format);
+        }else if((option == "--stats" || option == "--trace") && k+1 < argc){
+            if(!stats_enabled()){
+                std::cerr << option << " needs a build with RT_ENABLE_STATS (cmake -DRT_ENABLE_STATS=ON)\n";
+                return 1;
+            }
+            (option == "--stats" ? run_options.stats_path : run_options.trace_path) = argv[++k];
+        }else if(option == "--denoise"){
+            cam.denoise = true;
+        }else if(option == "--aov" && k+1 < argc){
+            run_options.aov_prefix = argv[++k];
+            cam.aov_buffers = true;
+        }else if(option == "--preview"){
+            run_options.preview = true;
+        }else if(option == "--frames" && k+1 < argc){
+            run_options.frames = std::atoi(argv[++k]);
+        }else{
+            std::cerr << "Usage: " << argv[0] << " [--output file] [--format p3|p6|png|pfm] [--dispatch virtual|static]"
+                      << " [--scene file] [--write-scene file] [--seed n] [--sampler random|stratified|halton|sobol]"
+                      << " [--max-depth n] [--min-bounces n] [--threads n]"
+                      << " [--farm n [--farm-tile size] [--farm-splits n]] [--worker]"
+                      << " [--partial file [--region x0 y0 x1 y1] [--sample-range first count]]"
+                      << " [--sequence pattern [--frames n]] [--preview] [--stats file] [--trace file] [--denoise] [--aov prefix]\n";
+            return 1;
+        }
+    }
+
+    if(run_options.farm_workers > 0){
+        // Workers load the same scene with the same settings, sharing the machine's threads //
+        int worker_threads = threads > 0 ? threads : std::max(1, Thread_pool::default_thread_count() / run_options.farm_workers);
+        run_options.farm.workers = run_options.farm_workers;
+        run_options.farm.quiet = cam.quiet;
+        run_options.farm.worker_command = {argv[0], "--worker", "--seed", std::to_string(cam.seed),
+                                           "--sampler", sampler_type_name(cam.sampler),
+                                           "--threads", std::to_string(worker_threads),
+                                           "--dispatch", static_dispatch ? "static" : "virtual"};
+        if(run_options.max_depth > 0){
+            run_options.farm.worker_command.push_back("--max-depth");
+            run_options.farm.worker_command.push_back(std::to_string(run_options.max_depth));
+        }
+        if(run_options.min_bounces >= 0){
+            run_options.farm.worker_command.push_back("--min-bounces");
+            run_options.farm.worker_command.push_back(std::to_string(run_options.min_bounces));
+        }
+        if(!scene_path.empty()){
+            run_options.farm.worker_command.push_back("--scene");
+            run_options.farm.worker_command.push_back(scene_path);
+        }
+    }
+
+    std::string error;
+    if(!scene_path.empty() && is_binary_scene(scene_path)){
+        // Spheres and their hierarchy are used straight from the mapped file //
+        if(static_dispatch || !write_path.empty()){
+            std::cerr << "A binary scene can only be rendered with virtual dispatch\n";
+            return 1;
+        }
+        Scene scene;
+        if(!load_scene_binary(scene_path, scene, cam, error)){
+            std::cerr << error << "\n";
+            return 1;
+        }
+        return run(scene, cam, run_options);
+    }
+
+    if(!scene_path.empty() || !write_path.empty()){
+        Scene_description description;
+        if(scene_path.empty()){
+            description = random_spheres_scene<Scene_description>();
+        }else if(!load_scene_text(scene_path, description, cam, error)){
+            std::cerr << error << "\n";
+            return 1;
+        }
+        if(!write_path.empty()){
+            apply_camera_options(run_options, cam);
+            bool binary = write_path.size() >= 5 && write_path.compare(write_path.size()-5, 5, ".rtsb") == 0;
+            bool ok = binary ? write_scene_binary(write_path, description, cam, error)
+                             : write_scene_text(write_path, description, cam, error);
+            if(!ok){
+                std::cerr << error << "\n";
+                return 1;
+            }
+            return 0;
+        }
+        run_options.animation = description.animation;
+        if(static_dispatch){
+            Static_scene scene;
+            description.populate(scene);
+            scene.build();
+            return run(scene, cam, run_options);
+        }
+        Scene scene;
+        description.populate(scene);
+        scene.world = Hittable_list(make_shared<Linear_bvh>(scene.world));
+        return run(scene, cam, run_options);
+    }
+
+    if(static_dispatch){
+        // Same scene stored by value, with the hierarchy built over the spheres directly //
+        auto scene = random_spheres_scene<Static_scene>();
+        scene.build();
+        return run(scene, cam, run_options);
+    }
+
+    // Create the scene world //
+    Scene scene = random_spheres_scene();
+
+    // Build the bounding volume hierarchy over the scene //
+    scene.world = Hittable_list(make_shared<Linear_bvh>(scene.world));
+
+    return run(scene, cam, run_options);
 }
@@ -0,0 +1,32 @@
+#ifndef RAY_PACKET_H
+#define RAY_PACKET_H
+
+#include "ray.h"
+#include "vec3.h"
+
+// A small group of coherent rays (e.g. neighbouring camera rays) stored as a structure of arrays //
+// so per ray loops over the lanes can be vectorized. Lanes past count are unused but zeroed, so //
+// loops running over all size lanes compute on defined values; their results are never accepted. //
+class Ray_packet{
+    public:
+    static constexpr int size = 8;
+
+    real ox[size] = {}, oy[size] = {}, oz[size] = {};
+    real dx[size] = {}, dy[size] = {}, dz[size] = {};
+    int count = 0;
+
+    void set(int lane, const Ray& r){
+        ox[lane] = r.origin()[0];
+        oy[lane] = r.origin()[1];
+        oz[lane] = r.origin()[2];
+        dx[lane] = r.direction()[0];
+        dy[lane] = r.direction()[1];
+        dz[lane] = r.direction()[2];
+    }
+
+    Ray ray(int lane) const{
+        return Ray(Point3(ox[lane], oy[lane], oz[lane]), Vec3(dx[lane], dy[lane], dz[lane]));
+    }
+};
+
+#endif
@@ -0,0 +1,118 @@
+#ifndef RNG_H
+#define RNG_H
+
+#include <cstdint>
+
+// Small, fast pseudo random generators. Every generator has the same interface: //
+// seed(seed, stream), next_u32(), next_u64() and next_double() in [0, 1). //
+// The renderer uses Rng, chosen at build time: PCG32 by default, xoshiro256+ with RT_RNG_XOSHIRO. //
+
+// SplitMix64 finalizer, turns consecutive integers into well spread 64 bit values //
+inline std::uint64_t splitmix64(std::uint64_t x){
+    x += 0x9e3779b97f4a7c15ULL;
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+    return x ^ (x >> 31);
+}
+
+// Combine two keys (e.g. a render seed and a sample index) into one seed //
+inline std::uint64_t mix_seed(std::uint64_t a, std::uint64_t b){
+    return splitmix64(a ^ splitmix64(b));
+}
+
+// PCG32 (XSH-RR) by M. O'Neill: 64 bits of state plus a stream selector, //
+// so every pixel can have its own independent sequence. //
+class Pcg32{
+    private:
+    std::uint64_t state;
+    std::uint64_t inc;
+
+    public:
+    Pcg32(){
+        seed(0x853c49e6748fea9bULL, 0xda3e39cb94b95bdbULL);
+    }
+    Pcg32(std::uint64_t seed_value, std::uint64_t stream){
+        seed(seed_value, stream);
+    }
+
+    void seed(std::uint64_t seed_value, std::uint64_t stream){
+        state = 0;
+        inc = (stream << 1) | 1;
+        next_u32();
+        state += seed_value;
+        next_u32();
+    }
+
+    std::uint32_t next_u32(){
+        std::uint64_t old = state;
+        state = old * 6364136223846793005ULL + inc;
+        auto xorshifted = std::uint32_t(((old >> 18) ^ old) >> 27);
+        auto rot = std::uint32_t(old >> 59);
+        return (xorshifted >> rot) | (xorshifted << ((-rot) & 31));
+    }
+
+    std::uint64_t next_u64(){
+        std::uint64_t hi = next_u32();
+        return (hi << 32) | next_u32();
+    }
+
+    double next_double(){
+        // 32 random bits are plenty for sampling and keep this to a single step //
+        return next_u32() * (1.0 / 4294967296.0);
+    }
+};
+
+// xoshiro256+ by Blackman and Vigna: 256 bits of state, fastest when full 53 bit doubles are wanted //
+class Xoshiro256_plus{
+    private:
+    std::uint64_t s[4];
+
+    static std::uint64_t rotl(std::uint64_t x, int k){
+        return (x << k) | (x >> (64 - k));
+    }
+
+    public:
+    Xoshiro256_plus(){
+        seed(0, 0);
+    }
+    Xoshiro256_plus(std::uint64_t seed_value, std::uint64_t stream){
+        seed(seed_value, stream);
+    }
+
+    void seed(std::uint64_t seed_value, std::uint64_t stream){
+        // Fill the state from SplitMix64 as the authors recommend, never all zero //
+        std::uint64_t x = mix_seed(seed_value, stream);
+        for(auto& word : s){
+            x += 0x9e3779b97f4a7c15ULL;
+            word = splitmix64(x);
+        }
+    }
+
+    std::uint64_t next_u64(){
+        std::uint64_t result = s[0] + s[3];
+        std::uint64_t t = s[1] << 17;
+        s[2] ^= s[0];
+        s[3] ^= s[1];
+        s[1] ^= s[2];
+        s[0] ^= s[3];
+        s[2] ^= t;
+        s[3] = rotl(s[3], 45);
+        return result;
+    }
+
+    std::uint32_t next_u32(){
+        return std::uint32_t(next_u64() >> 32);
+    }
+
+    double next_double(){
+        return (next_u64() >> 11) * (1.0 / 9007199254740992.0);
+    }
+};
+
+#if defined(RT_RNG_XOSHIRO)
+using Rng = Xoshiro256_plus;
+#else
+using Rng = Pcg32;
+#endif
+
+#endif
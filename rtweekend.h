@@ -5,7 +5,7 @@
 #include <iostream>
 #include <limits>
 #include <memory>
-#include <cstdlib>
+#include "rng.h"
 
 
 // C++ Std Usings
@@ -13,9 +13,17 @@
 using std::make_shared;
 using std::shared_ptr;
 
+// Scalar type of vectors, rays and hits: float when built with RT_SINGLE_PRECISION, double otherwise
+
+#ifdef RT_SINGLE_PRECISION
+using real = float;
+#else
+using real = double;
+#endif
+
 // Constants
 
-const double infinity = std::numeric_limits<double>::infinity();
+const real infinity = std::numeric_limits<real>::infinity();
 const double pi = 3.1415926535897932385;
 
 // Utility Functions
@@ -24,9 +32,20 @@ inline double degrees_to_radians(double degrees) {
     return degrees * pi / 180.0;
 }
 
+inline Rng& random_generator(){
+    // One generator per thread so samplers can run concurrently without sharing state //
+    thread_local Rng generator;
+    return generator;
+}
+
+inline void seed_random(std::uint64_t seed, std::uint64_t stream){
+    // Restart the calling thread's random sequence on the given stream //
+    random_generator().seed(seed, stream);
+}
+
 inline double random_double(){
     // Returns a random number between 0 and 1 //
-    return std::rand() / (RAND_MAX / 1.0);
+    return random_generator().next_double();
 }
 
 inline double random_double(double min, double max){
@@ -0,0 +1,302 @@
+#ifndef SAMPLER_H
+#define SAMPLER_H
+
+#include "onb.h"
+#include "rng.h"
+#include "rtweekend.h"
+#include "vec3.h"
+#include <cmath>
+#include <cstdint>
+#include <string>
+
+// Sample values of the path being traced. Every (pixel, sample) path asks for its numbers by //
+// dimension: 0-1 place the ray in the pixel, 2-3 on the lens, and each bounce starts a block of //
+// bounce_dimensions more: the scatter's 2D direction and 1D choices, from light_dimension on a //
+// light and a 2D point on it for next event estimation, and last the Russian roulette decision. //
+// The random sampler just hands out the path's own random stream, the others give each //
+// dimension a low discrepancy sequence over the samples of a pixel, decorrelated between pixels //
+// and dimensions by hashing in both, so the samples of a pixel cover the pixel, lens and bounce //
+// directions far more evenly. //
+
+enum class Sampler_type : std::uint32_t{
+    random,     //independent uniform numbers, what the renderer always did//
+    stratified, //one jittered stratum per sample in every dimension, strata in random order//
+    halton,     //Owen scrambled Halton, a prime base per dimension; random after the first 64//
+    sobol       //Owen scrambled Sobol pairs, shuffled per pixel and dimension (Burley 2020)//
+};
+
+inline const char* sampler_type_name(Sampler_type type){
+    static const char* names[] = {"random", "stratified", "halton", "sobol"};
+    return names[std::uint32_t(type)];
+}
+
+inline bool sampler_type_from_name(const std::string& name, Sampler_type& type){
+    for(std::uint32_t k=0; k<4; k++){
+        if(name == sampler_type_name(Sampler_type(k))){
+            type = Sampler_type(k);
+            return true;
+        }
+    }
+    return false;
+}
+
+constexpr std::uint32_t first_bounce_dimension = 4;
+constexpr std::uint32_t bounce_dimensions = 8;
+constexpr std::uint32_t light_dimension = 4;
+
+struct Sample_2d{
+    double u, v;
+};
+
+// Where the calling thread is in its current path; saved with the path's Rng wherever paths are //
+// suspended between bounces //
+struct Sample_state{
+    Sampler_type type = Sampler_type::random;
+    std::uint64_t key = 0; //hash of the seed and pixel//
+    std::uint32_t index = 0; //sample of the pixel//
+    std::uint32_t count = 1; //samples per pixel, the strata of the stratified sampler//
+    std::uint32_t dimension = 0; //next dimension handed out//
+};
+
+inline Sample_state& sample_state(){
+    thread_local Sample_state state;
+    return state;
+}
+
+// Start sample index of count of a pixel: restarts the random stream exactly as before samplers //
+// existed, so the random sampler renders the same images //
+inline void start_sample(Sampler_type type, std::uint64_t seed, std::uint64_t pixel, int index, int count){
+    seed_random(mix_seed(seed, index), pixel);
+    Sample_state& state = sample_state();
+    state.type = type;
+    state.key = mix_seed(seed, ~pixel);
+    state.index = std::uint32_t(index);
+    state.count = std::uint32_t(count > 0 ? count : 1);
+    state.dimension = 0;
+}
+
+// Scattering at bounce takes its dimensions from a block of its own, whatever earlier bounces used //
+inline void start_bounce(int bounce){
+    sample_state().dimension = first_bounce_dimension + std::uint32_t(bounce) * bounce_dimensions;
+}
+
+inline std::uint32_t reverse_bits(std::uint32_t x){
+    x = (x << 16) | (x >> 16);
+    x = ((x & 0x00ff00ffu) << 8) | ((x & 0xff00ff00u) >> 8);
+    x = ((x & 0x0f0f0f0fu) << 4) | ((x & 0xf0f0f0f0u) >> 4);
+    x = ((x & 0x33333333u) << 2) | ((x & 0xccccccccu) >> 2);
+    x = ((x & 0x55555555u) << 1) | ((x & 0xaaaaaaaau) >> 1);
+    return x;
+}
+
+// Hash whose low bits only depend on the low bits of x, so on the bits below them once reversed //
+inline std::uint32_t laine_karras_permutation(std::uint32_t x, std::uint32_t seed){
+    x += seed;
+    x ^= x * 0x6c50b47cu;
+    x ^= x * 0xb82f1e52u;
+    x ^= x * 0xc7afe638u;
+    x ^= x * 0x8d22f6e6u;
+    return x;
+}
+
+// Hash based Owen scrambling of the bits of x, most significant first (Burley 2020) //
+inline std::uint32_t nested_uniform_scramble(std::uint32_t x, std::uint32_t seed){
+    return reverse_bits(laine_karras_permutation(reverse_bits(x), seed));
+}
+
+// Second Sobol dimension; the first is reverse_bits(index). Its direction numbers are v_0 = 2^31, //
+// v_k = v_k-1 ^ (v_k-1 >> 1); a table of their XORs per index byte turns the 32 steps into four. //
+struct Sobol_dimension_1_table{
+    std::uint32_t bytes[4][256] = {};
+
+    constexpr Sobol_dimension_1_table(){
+        std::uint32_t v[32] = {};
+        v[0] = 1u << 31;
+        for(int k=1; k<32; k++){
+            v[k] = v[k-1] ^ (v[k-1] >> 1);
+        }
+        for(int b=0; b<4; b++){
+            for(int value=0; value<256; value++){
+                for(int bit=0; bit<8; bit++){
+                    if(value & (1 << bit)){
+                        bytes[b][value] ^= v[8*b + bit];
+                    }
+                }
+            }
+        }
+    }
+};
+
+inline std::uint32_t sobol_dimension_1(std::uint32_t index){
+    static constexpr Sobol_dimension_1_table table;
+    return table.bytes[0][index & 0xff] ^ table.bytes[1][(index >> 8) & 0xff]
+         ^ table.bytes[2][(index >> 16) & 0xff] ^ table.bytes[3][index >> 24];
+}
+
+// Element i of a random permutation of [0, l) picked by p, without storing it (Kensler 2013) //
+inline std::uint32_t permutation_element(std::uint32_t i, std::uint32_t l, std::uint32_t p){
+    std::uint32_t w = l - 1;
+    w |= w >> 1;
+    w |= w >> 2;
+    w |= w >> 4;
+    w |= w >> 8;
+    w |= w >> 16;
+    do{
+        i ^= p;
+        i *= 0xe170893du;
+        i ^= p >> 16;
+        i ^= (i & w) >> 4;
+        i ^= p >> 8;
+        i *= 0x0929eb3fu;
+        i ^= p >> 23;
+        i ^= (i & w) >> 1;
+        i *= 1 | p >> 27;
+        i *= 0x6935fa69u;
+        i ^= (i & w) >> 11;
+        i *= 0x74dcb303u;
+        i ^= (i & w) >> 2;
+        i *= 0x9e501cc3u;
+        i ^= (i & w) >> 2;
+        i *= 0xc860a3dfu;
+        i &= w;
+        i ^= i >> 5;
+    }while(i >= l);
+    return (i + p) % l;
+}
+
+inline double unit_from_bits(std::uint32_t bits){
+    return bits * (1.0 / 4294967296.0);
+}
+
+// Radical inverse of index in base with every digit permuted by a hash of the digits before it, //
+// which Owen scrambles the sequence. Cyclic shifts would be cheaper, but leave the first base //
+// indices on a line across two dimensions. Indices below count have no more digits than count - 1; //
+// past those every index has zeros, whose scrambled values only depend on the digits before, so a //
+// uniform number hashed from them stands in for the rest exactly. //
+inline double owen_scrambled_radical_inverse(std::uint32_t index, std::uint32_t base, std::uint32_t count,
+                                             std::uint64_t hash){
+    const double inv_base = 1.0 / base;
+    double scale = 1;
+    std::uint64_t reversed = 0;
+    for(std::uint32_t rest = count > 1 ? count - 1 : 1; rest; rest /= base){
+        std::uint32_t next = index / base;
+        std::uint32_t digit = index - next * base;
+        digit = permutation_element(digit, base, std::uint32_t(splitmix64(hash ^ reversed ^ std::uint64_t(scale * 0x1p32))));
+        reversed = reversed * base + digit;
+        scale *= inv_base;
+        index = next;
+    }
+    double tail = unit_from_bits(std::uint32_t(splitmix64(hash ^ reversed ^ std::uint64_t(scale * 0x1p32))));
+    return std::fmin((double(reversed) + tail) * scale, 0x1.fffffffffffffp-1);
+}
+
+inline std::uint32_t halton_base(std::uint32_t dimension){
+    static const std::uint16_t primes[64] = {
+        2, 3, 5, 7, 11, 13, 17, 19, 23, 29, 31, 37, 41, 43, 47, 53,
+        59, 61, 67, 71, 73, 79, 83, 89, 97, 101, 103, 107, 109, 113, 127, 131,
+        137, 139, 149, 151, 157, 163, 167, 173, 179, 181, 191, 193, 197, 199, 211, 223,
+        227, 229, 233, 239, 241, 251, 257, 263, 269, 271, 277, 281, 283, 293, 307, 311};
+    return dimension < 64 ? primes[dimension] : 0;
+}
+
+// The next dimension of the current path //
+inline double sample_1d(){
+    Sample_state& state = sample_state();
+    std::uint32_t dimension = state.dimension++;
+    std::uint64_t hash = mix_seed(state.key, dimension);
+    switch(state.type){
+    case Sampler_type::stratified:
+        if(state.index < state.count){
+            std::uint32_t stratum = permutation_element(state.index, state.count, std::uint32_t(hash));
+            return (stratum + random_double()) / state.count;
+        }
+        break;
+    case Sampler_type::halton:
+        if(std::uint32_t base = halton_base(dimension)){
+            return owen_scrambled_radical_inverse(state.index, base, state.count, hash);
+        }
+        break;
+    case Sampler_type::sobol:{
+        // Scrambling the first dimension, reverse_bits(index), needs no reversing of its own //
+        std::uint32_t index = nested_uniform_scramble(state.index, std::uint32_t(hash));
+        return unit_from_bits(reverse_bits(laine_karras_permutation(index, std::uint32_t(hash >> 32))));
+    }
+    case Sampler_type::random:
+        break;
+    }
+    return random_double();
+}
+
+// The next two dimensions of the current path, stratified together //
+inline Sample_2d sample_2d(){
+    Sample_state& state = sample_state();
+    std::uint32_t dimension = state.dimension;
+    state.dimension += 2;
+    std::uint64_t hash = mix_seed(state.key, dimension);
+    switch(state.type){
+    case Sampler_type::stratified:{
+        // A grid of about count cells, count of them picked in random order //
+        std::uint32_t nx = std::uint32_t(std::sqrt(double(state.count)));
+        std::uint32_t ny = (state.count + nx - 1) / nx;
+        if(state.index < state.count){
+            std::uint32_t cell = permutation_element(state.index, nx * ny, std::uint32_t(hash));
+            double u = (cell % nx + random_double()) / nx;
+            double v = (cell / nx + random_double()) / ny;
+            return {u, v};
+        }
+        break;
+    }
+    case Sampler_type::halton:{
+        std::uint32_t base_u = halton_base(dimension), base_v = halton_base(dimension + 1);
+        if(base_v){
+            return {owen_scrambled_radical_inverse(state.index, base_u, state.count, hash),
+                    owen_scrambled_radical_inverse(state.index, base_v, state.count, mix_seed(state.key, dimension + 1))};
+        }
+        break;
+    }
+    case Sampler_type::sobol:{
+        // The index is shuffled per pixel and dimension pair, so pairs are independent of each other //
+        std::uint32_t index = nested_uniform_scramble(state.index, std::uint32_t(hash));
+        std::uint64_t scramble = splitmix64(hash);
+        return {unit_from_bits(reverse_bits(laine_karras_permutation(index, std::uint32_t(scramble)))),
+                unit_from_bits(nested_uniform_scramble(sobol_dimension_1(index), std::uint32_t(scramble >> 32)))};
+    }
+    case Sampler_type::random:
+        break;
+    }
+    double u = random_double();
+    double v = random_double();
+    return {u, v};
+}
+
+// Light sampling at bounce takes the dimensions from light_dimension of the bounce's block //
+inline void start_light_sample(int bounce){
+    sample_state().dimension = first_bounce_dimension + std::uint32_t(bounce) * bounce_dimensions + light_dimension;
+}
+
+// Whether Russian roulette ends the path at bounce; the last dimension of the bounce's block, //
+// whatever the scatter took //
+inline double roulette_sample(int bounce){
+    sample_state().dimension = first_bounce_dimension + std::uint32_t(bounce + 1) * bounce_dimensions - 1;
+    return sample_1d();
+}
+
+// A direction uniform on the unit sphere, from the next 2D sample //
+inline Vec3 sample_unit_vector(){
+    Sample_2d s = sample_2d();
+    return sphere_direction(s.u, s.v);
+}
+
+// A point uniform in the unit disk, by the concentric map so strata stay compact //
+inline Vec3 sample_unit_disk(){
+    Sample_2d s = sample_2d();
+    return disk_point(s.u, s.v);
+}
+
+// A direction about the unit normal n, cosine weighted //
+inline Vec3 sample_cosine_direction(const Vec3& n){
+    Sample_2d s = sample_2d();
+    return Onb(n).to_world(cosine_direction(s.u, s.v));
+}
+
+#endif
@@ -0,0 +1,134 @@
+#ifndef SCENE_H
+#define SCENE_H
+
+#include "color.h"
+#include "hittable.h"
+#include "hittable_list.h"
+#include "instance.h"
+#include "interval.h"
+#include "lights.h"
+#include "material.h"
+#include "quad.h"
+#include "ray.h"
+#include "ray_packet.h"
+#include "sphere.h"
+#include "transform.h"
+#include "triangle_mesh.h"
+#include <cstddef>
+#include <typeindex>
+#include <typeinfo>
+#include <vector>
+
+// What the camera renders: the geometry, and the material table its hit records index into. //
+// Objects and materials are open class hierarchies reached through virtual calls, see //
+// Static_scene for the closed set alternative. Both offer the same functions to the Camera. //
+// Spheres and quads of an emitting material are added to the light list too. Meshes and instances //
+// may not use one: light sampling would never find them, yet their light would be weighed as if it //
+// could, so add_mesh and add_instance refuse them and return false. //
+class Scene{
+    public:
+    Hittable_list world;
+    Material_table materials;
+    std::vector<shared_ptr<Instance>> instances; //in the order added, for moving them later//
+    Light_list light_list;
+
+    template <typename Mat>
+    Material_id add_material(const Mat& mat){
+        return materials.add(make_shared<Mat>(mat));
+    }
+
+    void add_sphere(const Point3& center, real radius, Material_id mat){
+        world.add(make_shared<Sphere>(center, radius, mat));
+        light_list.add_sphere(center, radius, materials[mat].emission());
+    }
+
+    void add_quad(const Point3& corner, const Vec3& u, const Vec3& v, Material_id mat){
+        world.add(make_shared<Quad>(corner, u, v, mat));
+        light_list.add_quad(corner, u, v, materials[mat].emission());
+    }
+
+    // Materials that emit light, marked by Material_id //
+    std::vector<char> emitting_materials() const{
+        std::vector<char> marked(materials.size());
+        for(size_t k=0; k<materials.size(); k++){
+            Color3 emission = materials[Material_id(k)].emission();
+            marked[k] = emission[0] > 0 || emission[1] > 0 || emission[2] > 0;
+        }
+        return marked;
+    }
+
+    // Add a built mesh, its material should index this scene's table //
+    bool add_mesh(shared_ptr<Triangle_mesh> mesh){
+        if(mesh->uses_marked_material(emitting_materials())){
+            return false;
+        }
+        world.add(mesh);
+        return true;
+    }
+
+    // Place shared geometry, mat replaces its materials. Building a Linear_bvh over world then //
+    // gives the top level over the instances, each geometry keeps its own hierarchy below. //
+    bool add_instance(shared_ptr<const Hittable> object, const Transform& to_world,
+                      Material_id mat = Instance::keep_material){
+        auto instance = make_shared<Instance>(object, to_world, mat);
+        if(instance->uses_marked_material(emitting_materials())){
+            return false;
+        }
+        instances.push_back(instance);
+        world.add(instance);
+        return true;
+    }
+
+    size_t instance_count() const{
+        return instances.size();
+    }
+
+    // Move the index-th instance added; refit() before rendering again //
+    void set_instance_transform(size_t index, const Transform& to_world){
+        instances[index]->set_transform(to_world);
+    }
+
+    // Update the hierarchies over moved instances without rebuilding them //
+    void refit(){
+        world.refit();
+    }
+
+    bool hit(const Ray& r, Interval ray_t, Hit_record& rec) const{
+        return world.hit(r, ray_t, rec);
+    }
+
+    void hit_packet(const Ray_packet& rays, Packet_hit& hits) const{
+        world.hit_packet(rays, hits);
+    }
+
+    bool scatter(const Ray& ray_in, const Hit_record& rec, Color3& attenuation, Ray& scattered) const{
+        return materials[rec.mat].scatter(ray_in, rec, attenuation, scattered);
+    }
+
+    Color3 base_color(const Hit_record& rec) const{
+        return materials[rec.mat].base_color(rec);
+    }
+
+    Color3 emitted(const Hit_record& rec) const{
+        return materials[rec.mat].emitted(rec);
+    }
+
+    bool evaluate(const Ray& ray_in, const Hit_record& rec, const Vec3& direction, Color3& f_cos, double& pdf) const{
+        return materials[rec.mat].evaluate(ray_in, rec, direction, f_cos, pdf);
+    }
+
+    const Light_list& lights() const{
+        return light_list;
+    }
+
+    // Concrete type of a material, the wavefront integrator batches hits by it //
+    std::type_index material_type(Material_id mat) const{
+        return typeid(materials[mat]);
+    }
+
+    size_t material_count() const{
+        return materials.size();
+    }
+};
+
+#endif
@@ -0,0 +1,808 @@
+#ifndef SCENE_IO_H
+#define SCENE_IO_H
+
+#include "aabb.h"
+#include "animation.h"
+#include "bvh.h"
+#include "camera.h"
+#include "mapped_file.h"
+#include "material.h"
+#include "obj_loader.h"
+#include "rtweekend.h"
+#include "scene.h"
+#include "sphere_set.h"
+#include "stats.h"
+#include "transform.h"
+#include "triangle_mesh.h"
+#include "vec3.h"
+#include <charconv>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <limits>
+#include <memory>
+#include <string>
+#include <system_error>
+#include <unordered_map>
+#include <variant>
+#include <vector>
+
+// Scene files. The text format is one statement per line, '#' starts a comment: //
+//   camera <field> <values>              any public Camera field below, e.g. camera lookfrom 20 1 3 //
+//   material <name> lambertian r g b //
+//   material <name> metal r g b fuzz //
+//   material <name> dielectric refraction_index //
+//   material <name> light r g b          diffuse area light of this radiance //
+//   sphere x y z radius <material name> //
+//   quad x y z ux uy uz vx vy vz <material name>    corner and edges, facing along u x v //
+//   mesh <file.obj> <material name> [transforms]    path relative to the scene file //
+// Mesh transforms apply in the order written: translate x y z, scale s, scale x y z, //
+// rotate_x|rotate_y|rotate_z degrees, matrix followed by a 3x4 matrix by rows. Every mesh line //
+// naming the same file places another instance of one shared copy of its triangles. Meshes //
+// cannot use a light material, only spheres and quads are sampled as lights. //
+// Camera fields: image_width aspect_ratio samples_per_pixel vfov lookfrom lookat vup defocus_angle focus_dist //
+// max_depth min_bounces; binary scenes leave out the last two. //
+// Animated scenes add: //
+//   frames <count> [start end]           length of the sequence and times of its first and last frame //
+//   key <time> lookfrom|lookat x y z //
+//   key <time> focus_dist d //
+//   key <time> mesh <n> [translate x y z] [rotate x y z] [scale s | scale x y z] //
+// Mesh keys place the n-th mesh line, counting from 0, on top of its own transforms: scaled, rotated //
+// about x, y and z in degrees, then translated. Anything not given keeps its rest value. //
+// The binary format holds the same camera and materials plus the spheres as a built Sphere_set, its //
+// arrays and hierarchy laid out so a mapped file is used in place without parsing or building anything. //
+// Meshes, quads and lights are only stored in text scenes so far. //
+
+struct Sphere_params{
+    Point3 center;
+    real radius;
+    Material_id mat;
+};
+
+struct Quad_params{
+    Point3 corner;
+    Vec3 u, v;
+    Material_id mat;
+};
+
+struct Mesh_params{
+    std::string path; //as opened, the scene file's directory already prepended//
+    Material_id mat;
+    Transform to_world;
+    shared_ptr<const Triangle_mesh> mesh; //loaded and built, shared by every mesh of the same path//
+};
+
+// A scene as plain data, what the text format reads and writes. Offers add_material and add_sphere //
+// like Scene, so random_spheres_scene can build one, and populate() turns it into a renderable scene. //
+class Scene_description{
+    public:
+    std::vector<Material_params> materials;
+    std::vector<std::string> material_names;
+    std::vector<Sphere_params> spheres;
+    std::vector<Quad_params> quads;
+    std::vector<Mesh_params> meshes;
+    Animation animation; //instance n of the populated scene is meshes[n]//
+
+    template <typename Mat>
+    Material_id add_material(const Mat& mat){
+        return add_material(mat.params(), "m" + std::to_string(materials.size()));
+    }
+
+    Material_id add_material(const Material_params& params, const std::string& name){
+        materials.push_back(params);
+        material_names.push_back(name);
+        return Material_id(materials.size() - 1);
+    }
+
+    void add_sphere(const Point3& center, real radius, Material_id mat){
+        spheres.push_back({center, radius, mat});
+    }
+
+    void add_quad(const Point3& corner, const Vec3& u, const Vec3& v, Material_id mat){
+        quads.push_back({corner, u, v, mat});
+    }
+
+    // Place the mesh of an OBJ file with material mat, the file is only loaded the first time //
+    bool add_mesh(const std::string& path, Material_id mat, const Transform& to_world, std::string& error){
+        for(const auto& placed : meshes){
+            if(placed.path == path){
+                meshes.push_back({path, mat, to_world, placed.mesh});
+                return true;
+            }
+        }
+        auto mesh = make_shared<Triangle_mesh>(mat);
+        if(!load_obj(path, *mesh, error)){
+            return false;
+        }
+        meshes.push_back({path, mat, to_world, mesh});
+        return true;
+    }
+
+    // Add the materials, spheres, quads and meshes to a Scene or Static_scene //
+    template <typename Scene_type>
+    void populate(Scene_type& scene) const{
+        std::vector<Material_id> ids;
+        ids.reserve(materials.size());
+        for(const auto& params : materials){
+            ids.push_back(std::visit([&](const auto& mat){
+                return scene.add_material(mat);
+            }, make_material(params)));
+        }
+        for(const auto& sphere : spheres){
+            scene.add_sphere(sphere.center, sphere.radius, ids[sphere.mat]);
+        }
+        for(const auto& quad : quads){
+            scene.add_quad(quad.corner, quad.u, quad.v, ids[quad.mat]);
+        }
+        for(const auto& mesh : meshes){
+            scene.add_instance(mesh.mesh, mesh.to_world, ids[mesh.mat]);
+        }
+    }
+};
+
+// Tokens of one line of a text scene, pointing into the file contents //
+struct Scene_line{
+    static constexpr int max_tokens = 64;
+    const char* begin[max_tokens];
+    const char* end[max_tokens];
+    int count = 0;
+
+    bool is(int k, const char* word) const{
+        size_t n = std::strlen(word);
+        return k < count && size_t(end[k] - begin[k]) == n && std::memcmp(begin[k], word, n) == 0;
+    }
+
+    // Split [at, line_end) on blanks, stopping at a '#' comment; false when there are too many tokens //
+    bool split(const char* at, const char* line_end){
+        count = 0;
+        while(at < line_end && *at != '#'){
+            if(*at == ' ' || *at == '\t' || *at == '\r' || *at == '\n'){
+                at++;
+                continue;
+            }
+            if(count == max_tokens){
+                return false;
+            }
+            begin[count] = at;
+            while(at < line_end && *at != ' ' && *at != '\t' && *at != '\r' && *at != '\n' && *at != '#'){
+                at++;
+            }
+            end[count++] = at;
+        }
+        return true;
+    }
+
+    std::string text(int k) const{
+        return std::string(begin[k], end[k]);
+    }
+
+    template <typename T>
+    bool number(int k, T& value) const{
+        if(k >= count){
+            return false;
+        }
+        auto result = std::from_chars(begin[k], end[k], value);
+        return result.ec == std::errc() && result.ptr == end[k];
+    }
+
+    bool vector(int k, Vec3& v) const{
+        real x, y, z;
+        if(!number(k, x) || !number(k+1, y) || !number(k+2, z)){
+            return false;
+        }
+        v = Vec3(x, y, z);
+        return true;
+    }
+};
+
+// Read the transforms from token k on, each applied after the ones before it //
+inline bool parse_transforms(const Scene_line& line, int k, Transform& to_world){
+    while(k < line.count){
+        Transform step;
+        Vec3 v;
+        real s;
+        if(line.is(k, "translate") && line.vector(k+1, v)){
+            step = Transform::translate(v);
+            k += 4;
+        }else if(line.is(k, "scale") && line.vector(k+1, v)){
+            if(v[0] == 0 || v[1] == 0 || v[2] == 0){
+                return false;
+            }
+            step = Transform::scale(v);
+            k += 4;
+        }else if(line.is(k, "scale") && line.number(k+1, s)){
+            if(s == 0){
+                return false;
+            }
+            step = Transform::scale(Vec3(s, s, s));
+            k += 2;
+        }else if((line.is(k, "rotate_x") || line.is(k, "rotate_y") || line.is(k, "rotate_z")) && line.number(k+1, s)){
+            step = Transform::rotate(line.begin[k][7] - 'x', s);
+            k += 2;
+        }else if(line.is(k, "matrix")){
+            double rows[3][4];
+            for(int n=0; n<12; n++){
+                if(!line.number(k+1+n, rows[n/4][n%4])){
+                    return false;
+                }
+            }
+            bool ok;
+            step = Transform::matrix(rows, ok);
+            if(!ok){
+                return false;
+            }
+            k += 13;
+        }else{
+            return false;
+        }
+        to_world = step * to_world;
+    }
+    return true;
+}
+
+// Read "key <time> ..." into animation, n-th mesh keys need meshes up to n //
+inline bool parse_key_line(const Scene_line& line, Scene_description& scene){
+    double time;
+    if(!line.number(1, time)){
+        return false;
+    }
+    Point3 p;
+    double d;
+    if(line.count == 6 && line.is(2, "lookfrom") && line.vector(3, p)){
+        scene.animation.lookfrom.add(time, p);
+        return true;
+    }
+    if(line.count == 6 && line.is(2, "lookat") && line.vector(3, p)){
+        scene.animation.lookat.add(time, p);
+        return true;
+    }
+    if(line.count == 4 && line.is(2, "focus_dist") && line.number(3, d)){
+        scene.animation.focus_dist.add(time, d);
+        return true;
+    }
+    size_t n;
+    if(!line.is(2, "mesh") || !line.number(3, n) || n >= scene.meshes.size()){
+        return false;
+    }
+    Placement placement;
+    real s;
+    for(int k=4; k<line.count; ){
+        if(line.is(k, "translate") && line.vector(k+1, placement.translate)){
+            k += 4;
+        }else if(line.is(k, "rotate") && line.vector(k+1, placement.rotate)){
+            k += 4;
+        }else if(line.is(k, "scale") && line.vector(k+1, placement.scale)){
+            k += 4;
+        }else if(line.is(k, "scale") && line.number(k+1, s)){
+            placement.scale = Vec3(s, s, s);
+            k += 2;
+        }else{
+            return false;
+        }
+    }
+    if(placement.scale[0] == 0 || placement.scale[1] == 0 || placement.scale[2] == 0){
+        return false;
+    }
+    scene.animation.object(n, scene.meshes[n].to_world).placement.add(time, placement);
+    return true;
+}
+
+// Set one camera field from "camera <field> <values>" //
+inline bool parse_camera_line(const Scene_line& line, Camera& cam){
+    if(line.count == 3){
+        if(line.is(1, "image_width")) return line.number(2, cam.image_width);
+        if(line.is(1, "aspect_ratio")) return line.number(2, cam.aspect_ratio);
+        if(line.is(1, "samples_per_pixel")) return line.number(2, cam.samples_per_pixel);
+        if(line.is(1, "vfov")) return line.number(2, cam.vfov);
+        if(line.is(1, "defocus_angle")) return line.number(2, cam.defocus_angle);
+        if(line.is(1, "focus_dist")) return line.number(2, cam.focus_dist);
+        if(line.is(1, "max_depth")) return line.number(2, cam.max_depth);
+        if(line.is(1, "min_bounces")) return line.number(2, cam.min_bounces);
+    }else if(line.count == 5){
+        if(line.is(1, "lookfrom")) return line.vector(2, cam.lookfrom);
+        if(line.is(1, "lookat")) return line.vector(2, cam.lookat);
+        if(line.is(1, "vup")) return line.vector(2, cam.vup);
+    }
+    return false;
+}
+
+// Read a text scene. Lines are split in place in the mapped file and numbers parsed with from_chars, //
+// so there is no per line allocation and the result does not depend on the locale. //
+inline bool load_scene_text(const std::string& path, Scene_description& scene, Camera& cam, std::string& error){
+    RT_STAT_TIMER("load_scene");
+    Mapped_file file;
+    if(!file.open(path)){
+        error = "cannot read " + path;
+        return false;
+    }
+    std::unordered_map<std::string, Material_id> names;
+    std::string directory = path.substr(0, path.find_last_of('/') + 1);
+    const char* at = reinterpret_cast<const char*>(file.data());
+    const char* file_end = at + file.size();
+    for(int line_number=1; at < file_end; line_number++){
+        const char* line_end = static_cast<const char*>(std::memchr(at, '\n', size_t(file_end - at)));
+        if(!line_end){
+            line_end = file_end;
+        }
+
+        Scene_line line;
+        bool too_long = !line.split(at, line_end);
+        at = line_end + 1;
+
+        auto fail = [&](const std::string& message){
+            error = path + ":" + std::to_string(line_number) + ": " + message;
+            return false;
+        };
+        if(too_long){
+            return fail("too many values");
+        }
+        if(line.count == 0){
+            continue;
+        }
+
+        if(line.is(0, "camera")){
+            if(!parse_camera_line(line, cam)){
+                return fail("bad camera setting");
+            }
+        }else if(line.is(0, "material")){
+            Material_params params;
+            bool ok = false;
+            if(line.is(2, "lambertian") && line.count == 6){
+                params.kind = Material_params::Kind::lambertian;
+                ok = line.vector(3, params.albedo);
+            }else if(line.is(2, "metal") && line.count == 7){
+                params.kind = Material_params::Kind::metal;
+                ok = line.vector(3, params.albedo) && line.number(6, params.fuzz);
+            }else if(line.is(2, "dielectric") && line.count == 4){
+                params.kind = Material_params::Kind::dielectric;
+                ok = line.number(3, params.refraction_index);
+            }else if(line.is(2, "light") && line.count == 6){
+                params.kind = Material_params::Kind::diffuse_light;
+                ok = line.vector(3, params.emission);
+            }
+            if(!ok){
+                return fail("bad material");
+            }
+            std::string name = line.text(1);
+            if(names.count(name)){
+                return fail("material " + name + " defined twice");
+            }
+            names[name] = scene.add_material(params, name);
+        }else if(line.is(0, "sphere")){
+            Point3 center;
+            real radius;
+            if(line.count != 6 || !line.vector(1, center) || !line.number(4, radius)){
+                return fail("bad sphere");
+            }
+            auto found = names.find(line.text(5));
+            if(found == names.end()){
+                return fail("unknown material " + line.text(5));
+            }
+            scene.add_sphere(center, radius, found->second);
+        }else if(line.is(0, "quad")){
+            Point3 corner;
+            Vec3 u, v;
+            if(line.count != 11 || !line.vector(1, corner) || !line.vector(4, u) || !line.vector(7, v)){
+                return fail("bad quad");
+            }
+            auto found = names.find(line.text(10));
+            if(found == names.end()){
+                return fail("unknown material " + line.text(10));
+            }
+            scene.add_quad(corner, u, v, found->second);
+        }else if(line.is(0, "mesh")){
+            Transform to_world;
+            if(line.count < 3 || !parse_transforms(line, 3, to_world)){
+                return fail("bad mesh");
+            }
+            auto found = names.find(line.text(2));
+            if(found == names.end()){
+                return fail("unknown material " + line.text(2));
+            }
+            if(scene.materials[found->second].kind == Material_params::Kind::diffuse_light){
+                return fail("meshes cannot be lights");
+            }
+            std::string mesh_path = line.text(1);
+            if(mesh_path[0] != '/'){
+                mesh_path = directory + mesh_path;
+            }
+            std::string mesh_error;
+            if(!scene.add_mesh(mesh_path, found->second, to_world, mesh_error)){
+                return fail(mesh_error);
+            }
+        }else if(line.is(0, "frames")){
+            auto& animation = scene.animation;
+            bool ok = (line.count == 2 || (line.count == 4 && line.number(2, animation.start) && line.number(3, animation.end)))
+                   && line.number(1, animation.frames) && animation.frames >= 0;
+            if(!ok){
+                return fail("bad frames");
+            }
+        }else if(line.is(0, "key")){
+            if(!parse_key_line(line, scene)){
+                return fail("bad key");
+            }
+        }else{
+            return fail("unknown statement " + line.text(0));
+        }
+    }
+    return true;
+}
+
+// Shortest text that reads back as exactly the same value //
+template <typename T>
+void append_number(std::string& out, T value){
+    char text[32];
+    auto end = std::to_chars(text, text + sizeof(text), value).ptr;
+    out += ' ';
+    out.append(text, end);
+}
+
+inline void append_vector(std::string& out, const Vec3& v){
+    append_number(out, v[0]);
+    append_number(out, v[1]);
+    append_number(out, v[2]);
+}
+
+inline bool write_file(const std::string& path, const void* data, size_t size){
+    std::FILE* file = std::fopen(path.c_str(), "wb");
+    if(!file){
+        return false;
+    }
+    bool ok = std::fwrite(data, 1, size, file) == size;
+    return std::fclose(file) == 0 && ok;
+}
+
+// How a scene written to scene_path names the mesh file at mesh_path (absolute, or relative to the //
+// working directory like every path held in Mesh_params): relative to that scene's directory, //
+// which the loader resolves it against, or absolute when no relative path leads there //
+inline std::string mesh_path_for(const std::string& scene_path, const std::string& mesh_path){
+    namespace fs = std::filesystem;
+    std::error_code error;
+    fs::path mesh = fs::absolute(mesh_path, error).lexically_normal();
+    if(error){
+        return mesh_path;
+    }
+    fs::path directory = fs::absolute(scene_path, error).lexically_normal().parent_path();
+    if(error){
+        return mesh.generic_string();
+    }
+    fs::path relative = mesh.lexically_relative(directory);
+    return relative.empty() ? mesh.generic_string() : relative.generic_string();
+}
+
+inline bool write_scene_text(const std::string& path, const Scene_description& scene, const Camera& cam, std::string& error){
+    std::string out = "# rayTracer scene\n";
+    out += "camera image_width"; append_number(out, cam.image_width); out += '\n';
+    out += "camera aspect_ratio"; append_number(out, cam.aspect_ratio); out += '\n';
+    out += "camera samples_per_pixel"; append_number(out, cam.samples_per_pixel); out += '\n';
+    out += "camera vfov"; append_number(out, cam.vfov); out += '\n';
+    out += "camera lookfrom"; append_vector(out, cam.lookfrom); out += '\n';
+    out += "camera lookat"; append_vector(out, cam.lookat); out += '\n';
+    out += "camera vup"; append_vector(out, cam.vup); out += '\n';
+    out += "camera defocus_angle"; append_number(out, cam.defocus_angle); out += '\n';
+    out += "camera focus_dist"; append_number(out, cam.focus_dist); out += '\n';
+    out += "camera max_depth"; append_number(out, cam.max_depth); out += '\n';
+    out += "camera min_bounces"; append_number(out, cam.min_bounces); out += '\n';
+
+    for(size_t k=0; k<scene.materials.size(); k++){
+        const auto& params = scene.materials[k];
+        out += "material " + scene.material_names[k];
+        switch(params.kind){
+            case Material_params::Kind::metal:
+                out += " metal";
+                append_vector(out, params.albedo);
+                append_number(out, params.fuzz);
+                break;
+            case Material_params::Kind::dielectric:
+                out += " dielectric";
+                append_number(out, params.refraction_index);
+                break;
+            case Material_params::Kind::diffuse_light:
+                out += " light";
+                append_vector(out, params.emission);
+                break;
+            default:
+                out += " lambertian";
+                append_vector(out, params.albedo);
+        }
+        out += '\n';
+    }
+    for(const auto& sphere : scene.spheres){
+        out += "sphere";
+        append_vector(out, sphere.center);
+        append_number(out, sphere.radius);
+        out += ' ' + scene.material_names[sphere.mat] + '\n';
+    }
+    for(const auto& quad : scene.quads){
+        out += "quad";
+        append_vector(out, quad.corner);
+        append_vector(out, quad.u);
+        append_vector(out, quad.v);
+        out += ' ' + scene.material_names[quad.mat] + '\n';
+    }
+    for(const auto& mesh : scene.meshes){
+        out += "mesh " + mesh_path_for(path, mesh.path) + ' ' + scene.material_names[mesh.mat];
+        if(!mesh.to_world.is_identity()){
+            double rows[3][4];
+            mesh.to_world.rows(rows);
+            out += " matrix";
+            for(int n=0; n<12; n++){
+                append_number(out, rows[n/4][n%4]);
+            }
+        }
+        out += '\n';
+    }
+
+    const Animation& animation = scene.animation;
+    if(animation.frames > 0){
+        out += "frames"; append_number(out, animation.frames);
+        append_number(out, animation.start); append_number(out, animation.end); out += '\n';
+    }
+    auto append_keys = [&](const Keyframes<Point3>& keys, const char* field){
+        for(const auto& key : keys.keys){
+            out += "key"; append_number(out, key.time);
+            out += ' '; out += field; append_vector(out, key.value); out += '\n';
+        }
+    };
+    append_keys(animation.lookfrom, "lookfrom");
+    append_keys(animation.lookat, "lookat");
+    for(const auto& key : animation.focus_dist.keys){
+        out += "key"; append_number(out, key.time);
+        out += " focus_dist"; append_number(out, key.value); out += '\n';
+    }
+    for(const auto& track : animation.objects){
+        for(const auto& key : track.placement.keys){
+            out += "key"; append_number(out, key.time);
+            out += " mesh"; append_number(out, track.instance);
+            out += " translate"; append_vector(out, key.value.translate);
+            out += " rotate"; append_vector(out, key.value.rotate);
+            out += " scale"; append_vector(out, key.value.scale); out += '\n';
+        }
+    }
+    if(!write_file(path, out.data(), out.size())){
+        error = "cannot write " + path;
+        return false;
+    }
+    return true;
+}
+
+// Binary scene layout. Written and read in the host byte order, byte_order tells a mismatch apart. //
+// Every array starts on a 64 byte boundary of the file, so it is aligned in the mapping too. //
+static const char binary_scene_magic[8] = {'R', 'T', 'S', 'C', 'E', 'N', 'E', 0};
+static const std::uint32_t binary_scene_version = 1;
+static const std::uint32_t binary_scene_byte_order = 0x01020304;
+
+struct Binary_scene_header{
+    char magic[8];
+    std::uint32_t version;
+    std::uint32_t byte_order;
+    std::int32_t image_width;
+    std::int32_t samples_per_pixel;
+    double aspect_ratio;
+    double vfov;
+    double lookfrom[3];
+    double lookat[3];
+    double vup[3];
+    double defocus_angle;
+    double focus_dist;
+    double bounds_min[3];
+    double bounds_max[3];
+    std::uint64_t material_count;
+    std::uint64_t sphere_count;
+    std::uint64_t node_count;
+    std::uint64_t material_offset;
+    std::uint64_t center_offset[3];
+    std::uint64_t radius_offset;
+    std::uint64_t sphere_material_offset;
+    std::uint64_t node_offset;
+};
+
+struct Binary_material{
+    std::uint32_t kind;
+    std::uint32_t pad;
+    double albedo[3];
+    double fuzz;
+    double refraction_index;
+};
+
+// Write the scene with its spheres built into a Sphere_set hierarchy //
+inline bool write_scene_binary(const std::string& path, const Scene_description& scene, const Camera& cam, std::string& error){
+    if(!scene.meshes.empty()){
+        error = "binary scenes cannot hold meshes yet, write a text scene";
+        return false;
+    }
+    if(!scene.animation.empty()){
+        error = "binary scenes cannot hold animations, write a text scene";
+        return false;
+    }
+    bool has_light = false;
+    for(const auto& params : scene.materials){
+        has_light |= params.kind == Material_params::Kind::diffuse_light;
+    }
+    if(!scene.quads.empty() || has_light){
+        error = "binary scenes cannot hold quads or lights yet, write a text scene";
+        return false;
+    }
+    Sphere_set set;
+    for(const auto& sphere : scene.spheres){
+        set.add(sphere.center, sphere.radius, sphere.mat);
+    }
+    set.build();
+    Sphere_set_arrays arrays = set.arrays();
+
+    Binary_scene_header header = {};
+    std::memcpy(header.magic, binary_scene_magic, sizeof(header.magic));
+    header.version = binary_scene_version;
+    header.byte_order = binary_scene_byte_order;
+    header.image_width = cam.image_width;
+    header.samples_per_pixel = cam.samples_per_pixel;
+    header.aspect_ratio = cam.aspect_ratio;
+    header.vfov = cam.vfov;
+    header.defocus_angle = cam.defocus_angle;
+    header.focus_dist = cam.focus_dist;
+    for(int axis=0; axis<3; axis++){
+        header.lookfrom[axis] = cam.lookfrom[axis];
+        header.lookat[axis] = cam.lookat[axis];
+        header.vup[axis] = cam.vup[axis];
+        header.bounds_min[axis] = arrays.bbox.axis_interval(axis).min;
+        header.bounds_max[axis] = arrays.bbox.axis_interval(axis).max;
+    }
+    header.material_count = scene.materials.size();
+    header.sphere_count = arrays.count;
+    header.node_count = arrays.node_count;
+
+    std::vector<unsigned char> out(sizeof(header));
+    auto append = [&](const void* data, size_t size){
+        out.resize((out.size() + 63) & ~size_t(63));
+        std::uint64_t offset = out.size();
+        out.resize(out.size() + size);
+        if(size > 0){
+            std::memcpy(&out[offset], data, size);
+        }
+        return offset;
+    };
+    std::vector<Binary_material> materials(scene.materials.size());
+    for(size_t k=0; k<materials.size(); k++){
+        const auto& params = scene.materials[k];
+        materials[k] = {};
+        materials[k].kind = std::uint32_t(params.kind);
+        for(int c=0; c<3; c++){
+            materials[k].albedo[c] = params.albedo[c];
+        }
+        materials[k].fuzz = params.fuzz;
+        materials[k].refraction_index = params.refraction_index;
+    }
+    header.material_offset = append(materials.data(), materials.size() * sizeof(Binary_material));
+    header.center_offset[0] = append(arrays.center_x, arrays.count * sizeof(double));
+    header.center_offset[1] = append(arrays.center_y, arrays.count * sizeof(double));
+    header.center_offset[2] = append(arrays.center_z, arrays.count * sizeof(double));
+    header.radius_offset = append(arrays.radius, arrays.count * sizeof(double));
+    header.sphere_material_offset = append(arrays.material, arrays.count * sizeof(Material_id));
+    header.node_offset = append(arrays.nodes, arrays.node_count * sizeof(Bvh_flat_node));
+    std::memcpy(out.data(), &header, sizeof(header));
+
+    if(!write_file(path, out.data(), out.size())){
+        error = "cannot write " + path;
+        return false;
+    }
+    return true;
+}
+
+inline bool is_binary_scene(const std::string& path){
+    char magic[sizeof(binary_scene_magic)] = {};
+    std::FILE* file = std::fopen(path.c_str(), "rb");
+    if(!file){
+        return false;
+    }
+    bool ok = std::fread(magic, 1, sizeof(magic), file) == sizeof(magic);
+    std::fclose(file);
+    return ok && std::memcmp(magic, binary_scene_magic, sizeof(magic)) == 0;
+}
+
+// Load a binary scene: the camera settings and materials are copied, the spheres and their hierarchy //
+// are used straight from the mapped file, which stays mapped as long as the scene refers to it. //
+// Everything a render indexes with is checked once here: array extents, material kinds, the //
+// spheres' material ids and the hierarchy's links and leaf ranges. Any failure is reported as //
+// truncated or corrupt rather than read out of bounds later. //
+inline bool load_scene_binary(const std::string& path, Scene& scene, Camera& cam, std::string& error){
+    RT_STAT_TIMER("load_scene");
+    auto file = std::make_shared<Mapped_file>();
+    if(!file->open(path)){
+        error = "cannot read " + path;
+        return false;
+    }
+    Binary_scene_header header;
+    if(file->size() < sizeof(header)){
+        error = path + ": not a binary scene";
+        return false;
+    }
+    std::memcpy(&header, file->data(), sizeof(header));
+    if(std::memcmp(header.magic, binary_scene_magic, sizeof(header.magic)) != 0){
+        error = path + ": not a binary scene";
+        return false;
+    }
+    if(header.version != binary_scene_version || header.byte_order != binary_scene_byte_order){
+        error = path + ": unsupported version or byte order";
+        return false;
+    }
+    auto fits = [&](std::uint64_t offset, std::uint64_t count, std::uint64_t size){
+        return offset % 64 == 0 && offset <= file->size() && count <= (file->size() - offset) / size;
+    };
+    if(!fits(header.material_offset, header.material_count, sizeof(Binary_material))
+       || !fits(header.center_offset[0], header.sphere_count, sizeof(double))
+       || !fits(header.center_offset[1], header.sphere_count, sizeof(double))
+       || !fits(header.center_offset[2], header.sphere_count, sizeof(double))
+       || !fits(header.radius_offset, header.sphere_count, sizeof(double))
+       || !fits(header.sphere_material_offset, header.sphere_count, sizeof(Material_id))
+       || !fits(header.node_offset, header.node_count, sizeof(Bvh_flat_node))
+       || (header.sphere_count > 0 && header.node_count == 0)
+       || header.sphere_count > std::numeric_limits<std::uint32_t>::max()
+       || header.image_width < 1 || header.samples_per_pixel < 1){
+        error = path + ": truncated or corrupt";
+        return false;
+    }
+
+    const unsigned char* base = file->data();
+    bool contents_ok = Flat_bvh::valid(reinterpret_cast<const Bvh_flat_node*>(base + header.node_offset),
+                                       size_t(header.node_count), size_t(header.sphere_count));
+    for(std::uint64_t k=0; contents_ok && k<header.material_count; k++){
+        std::uint32_t kind;
+        std::memcpy(&kind, base + header.material_offset + k*sizeof(Binary_material) + offsetof(Binary_material, kind), sizeof(kind));
+        contents_ok = kind <= std::uint32_t(Material_params::Kind::dielectric);
+    }
+    for(std::uint64_t k=0; contents_ok && k<header.sphere_count; k++){
+        Material_id mat;
+        std::memcpy(&mat, base + header.sphere_material_offset + k*sizeof(Material_id), sizeof(mat));
+        contents_ok = mat < header.material_count;
+    }
+    if(!contents_ok){
+        error = path + ": truncated or corrupt";
+        return false;
+    }
+
+    if(scene.material_count() != 0){
+        error = path + ": a binary scene must be loaded into an empty scene";
+        return false;
+    }
+
+    cam.image_width = header.image_width;
+    cam.samples_per_pixel = header.samples_per_pixel;
+    cam.aspect_ratio = header.aspect_ratio;
+    cam.vfov = header.vfov;
+    cam.lookfrom = Point3(header.lookfrom[0], header.lookfrom[1], header.lookfrom[2]);
+    cam.lookat = Point3(header.lookat[0], header.lookat[1], header.lookat[2]);
+    cam.vup = Vec3(header.vup[0], header.vup[1], header.vup[2]);
+    cam.defocus_angle = header.defocus_angle;
+    cam.focus_dist = header.focus_dist;
+
+    for(std::uint64_t k=0; k<header.material_count; k++){
+        Binary_material stored;
+        std::memcpy(&stored, base + header.material_offset + k*sizeof(Binary_material), sizeof(stored));
+        Material_params params;
+        params.kind = Material_params::Kind(stored.kind);
+        params.albedo = Color3(stored.albedo[0], stored.albedo[1], stored.albedo[2]);
+        params.fuzz = stored.fuzz;
+        params.refraction_index = stored.refraction_index;
+        std::visit([&](const auto& mat){ scene.add_material(mat); }, make_material(params));
+    }
+
+    Sphere_set_arrays arrays;
+    arrays.count = header.sphere_count;
+    arrays.center_x = reinterpret_cast<const double*>(base + header.center_offset[0]);
+    arrays.center_y = reinterpret_cast<const double*>(base + header.center_offset[1]);
+    arrays.center_z = reinterpret_cast<const double*>(base + header.center_offset[2]);
+    arrays.radius = reinterpret_cast<const double*>(base + header.radius_offset);
+    arrays.material = reinterpret_cast<const Material_id*>(base + header.sphere_material_offset);
+    arrays.node_count = header.node_count;
+    arrays.nodes = reinterpret_cast<const Bvh_flat_node*>(base + header.node_offset);
+    arrays.bbox = Aabb(Point3(header.bounds_min[0], header.bounds_min[1], header.bounds_min[2]),
+                       Point3(header.bounds_max[0], header.bounds_max[1], header.bounds_max[2]));
+    auto set = make_shared<Sphere_set>();
+    set->attach(arrays, file);
+    scene.world.add(set);
+    return true;
+}
+
+#endif
@@ -0,0 +1,61 @@
+#ifndef SCENES_H
+#define SCENES_H
+
+#include "hittable_list.h"
+#include "material.h"
+#include "rtweekend.h"
+#include "scene.h"
+#include "static_scene.h"
+#include "sphere.h"
+#include "vec3.h"
+
+// The random spheres scene rendered by rayTracing.cpp, shared with the benchmarks. Builds a Scene //
+// or a Static_scene (which still needs build()). The layout only depends on the calling thread's //
+// random sequence, seed it first for a fixed scene. //
+template <typename Scene_type = Scene>
+Scene_type random_spheres_scene(){
+    Scene_type scene;
+    auto ground_material = scene.add_material(Lambertian(Color3(0.5, 0.5, 0.5)));
+    scene.add_sphere(Point3(0,-1000,0), 1000, ground_material);
+
+    for (int a = -11; a < 11; a++) {
+        for (int b = -11; b < 11; b++) {
+            auto choose_mat = random_double();
+            Point3 center(a + 0.9*random_double(), 0.18, b + 0.9*random_double());
+
+            if ((center - Point3(4, 0.2, 0)).length() > 0.9) {
+                Material_id sphere_material;
+
+                if (choose_mat < 0.7) {
+                    // diffuse
+                    auto albedo = Color3::random() * Color3::random();
+                    sphere_material = scene.add_material(Lambertian(albedo));
+                    scene.add_sphere(center, 0.2, sphere_material);
+                } else if (choose_mat < 0.95) {
+                    // metal
+                    auto albedo = Color3::random(0.5, 1);
+                    auto fuzz = random_double(0, 0.5);
+                    sphere_material = scene.add_material(Metal(albedo, fuzz));
+                    scene.add_sphere(center, 0.2, sphere_material);
+                } else {
+                    // glass
+                    sphere_material = scene.add_material(Dielectric(1.5));
+                    scene.add_sphere(center, 0.2, sphere_material);
+                }
+            }
+        }
+    }
+
+    /*auto material1 = make_shared<Dielectric>(1.5);
+    world.add(make_shared<Sphere>(Point3(0, 1, 0), 1.0, material1));
+    */
+    auto material2 = scene.add_material(Lambertian(Color3(0.4, 0.2, 0.1)));
+    scene.add_sphere(Point3(-4, 1, 0), 1.0, material2);
+
+    auto material3 = scene.add_material(Metal(Color3(0.7, 0.6, 0.5), 0.0));
+    scene.add_sphere(Point3(4, 1, 0), 1.0, material3);
+
+    return scene;
+}
+
+#endif
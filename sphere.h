@@ -1,6 +1,7 @@
 #ifndef  SPHERE_H
 #define  SPHERE_H
 
+#include "aabb.h"
 #include "hittable.h"
 #include "interval.h"
 #include "ray.h"
@@ -8,14 +9,18 @@
 #include "vec3.h"
 #include <cmath>
 #include <memory>
-class Sphere : public Hittable{
+class Sphere final : public Hittable{
     private:
     Point3 center;
-    double radius;
-    shared_ptr<Material> mat;
+    real radius;
+    Material_id mat;
+    Aabb bbox;
 
     public:
-    Sphere(const Point3& center, double radius, shared_ptr<Material> mat) : center(center), radius(std::fmax(0,radius)), mat(mat) {};
+    Sphere(const Point3& center, real radius, Material_id mat) : center(center), radius(std::fmax(real(0),radius)), mat(mat) {
+        auto rvec = Vec3(radius, radius, radius);
+        bbox = Aabb(center - rvec, center + rvec);
+    };
     bool hit(const Ray& r, Interval ray_t,  Hit_record& rec) const override{
         auto oc = center - r.origin();
         auto a = r.direction().length_squared();
@@ -55,6 +60,51 @@ class Sphere : public Hittable{
         return false;
     }
 
+    void hit_packet(const Ray_packet& rays, Packet_hit& hits) const override{
+        // Same steps as hit() done lane by lane over the packet arrays, only hits fill records //
+        real roots[Ray_packet::size];
+        bool found[Ray_packet::size];
+        for(int lane=0; lane<Ray_packet::size; lane++){
+            auto ocx = center[0] - rays.ox[lane];
+            auto ocy = center[1] - rays.oy[lane];
+            auto ocz = center[2] - rays.oz[lane];
+            auto a = rays.dx[lane]*rays.dx[lane] + rays.dy[lane]*rays.dy[lane] + rays.dz[lane]*rays.dz[lane];
+            auto h = rays.dx[lane]*ocx + rays.dy[lane]*ocy + rays.dz[lane]*ocz;
+            auto c = (ocx*ocx + ocy*ocy + ocz*ocz) - radius*radius;
+            auto discriminant = h*h - a*c;
+            auto sqrt = std::sqrt(discriminant < 0 ? 0 : discriminant);
+            auto root1 = (h-sqrt) / a;
+            auto root2 = (h+sqrt) / a;
+            bool ok1 = root1 >= hits.t_min && root1 <= hits.closest[lane];
+            bool ok2 = root2 >= hits.t_min && root2 <= hits.closest[lane];
+            roots[lane] = ok1 ? root1 : root2;
+            found[lane] = discriminant >= 0 && (ok1 || ok2);
+        }
+
+        for(int lane=0; lane<rays.count; lane++){
+            if(!found[lane]){
+                continue;
+            }
+            Ray r = rays.ray(lane);
+            Hit_record& rec = hits.rec[lane];
+            rec.t = roots[lane];
+            rec.P = r.at(rec.t);
+            Vec3 outward_normal = (rec.P - center) / radius;
+            rec.set_face_normal(r, outward_normal);
+            rec.mat = mat;
+            hits.closest[lane] = rec.t;
+            hits.hit[lane] = true;
+        }
+    }
+
+    bool uses_marked_material(const std::vector<char>& marked) const override{
+        return is_marked(marked, mat);
+    }
+
+    Aabb bounding_box() const override{
+        return bbox;
+    }
+
 };
 
 #endif
@@ -0,0 +1,315 @@
+#ifndef SPHERE_SET_H
+#define SPHERE_SET_H
+
+#include "aabb.h"
+#include "buffer.h"
+#include "bvh.h"
+#include "hittable.h"
+#include "interval.h"
+#include "ray.h"
+#include "rtweekend.h"
+#include "stats.h"
+#include "vec3.h"
+#include <cmath>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+// The intersection kernel is picked at build time: AVX2 tests 4 spheres per step, SSE2 tests 2, //
+// anything else (or RT_NO_SIMD) uses the scalar loop. Lanes are doubles so the large ground //
+// sphere keeps the precision of a double Sphere::hit, also in RT_SINGLE_PRECISION builds. //
+#if !defined(RT_NO_SIMD) && defined(__AVX2__)
+#include <immintrin.h>
+#define SPHERE_SET_AVX2
+#elif !defined(RT_NO_SIMD) && defined(__SSE2__)
+#include <emmintrin.h>
+#define SPHERE_SET_SSE2
+#endif
+
+// The arrays of a built Sphere_set in leaf order and its hierarchy, what the binary scene format stores //
+struct Sphere_set_arrays{
+    size_t count = 0;
+    const double* center_x = nullptr;
+    const double* center_y = nullptr;
+    const double* center_z = nullptr;
+    const double* radius = nullptr;
+    const Material_id* material = nullptr;
+    size_t node_count = 0;
+    const Bvh_flat_node* nodes = nullptr;
+    Aabb bbox;
+};
+
+// Many spheres stored as a structure of arrays. A hit test only looks for the index of the //
+// closest sphere, the hit record is filled once at the end. //
+class Sphere_set : public Hittable{
+    private:
+    Buffer<double> center_x, center_y, center_z, radius;
+    Buffer<Material_id> material;
+    Flat_bvh bvh;
+    bool built = false;
+    Aabb bbox;
+
+    Aabb sphere_box(size_t k) const{
+        auto rvec = Vec3(radius[k], radius[k], radius[k]);
+        auto center = Point3(center_x[k], center_y[k], center_z[k]);
+        return Aabb(center - rvec, center + rvec);
+    }
+
+    // Reorder every array so the spheres of each leaf are adjacent //
+    template <typename T>
+    static void apply_order(Buffer<T>& values, const std::vector<std::uint32_t>& order){
+        std::vector<T> sorted(values.size());
+        for(size_t k=0; k<order.size(); k++){
+            sorted[k] = values[order[k]];
+        }
+        values.vector().swap(sorted);
+    }
+
+    // Scalar version of Sphere::hit returning only the root, used for the fallback and SIMD tails //
+    bool hit_one(size_t k, const Ray& r, double t_min, double t_max, double& t) const{
+        auto origin = Vec3_t<double>(r.origin()[0], r.origin()[1], r.origin()[2]);
+        auto direction = Vec3_t<double>(r.direction()[0], r.direction()[1], r.direction()[2]);
+        auto oc = Vec3_t<double>(center_x[k], center_y[k], center_z[k]) - origin;
+        auto a = direction.length_squared();
+        auto h = dot(direction, oc);
+        auto c = oc.length_squared() - radius[k]*radius[k];
+        auto discriminant = h*h - a*c;
+        if(discriminant < 0){
+            return false;
+        }
+        auto sqrt = std::sqrt(discriminant);
+        auto root = (h-sqrt) / a;
+        if(root < t_min || root > t_max){
+            root = (h+sqrt) / a;
+            if(root < t_min || root > t_max){
+                return false;
+            }
+        }
+        t = root;
+        return true;
+    }
+
+    // Test spheres [first, first+count) against [t_min, closest], lower closest on a hit //
+    // and return the index of the closest sphere hit, or -1 //
+    long closest_in_range(size_t first, size_t count, const Ray& r, double t_min, double& closest) const{
+        long best = -1;
+        size_t k = first;
+        size_t end = first + count;
+
+#if defined(SPHERE_SET_AVX2)
+        const __m256d ox = _mm256_set1_pd(r.origin()[0]);
+        const __m256d oy = _mm256_set1_pd(r.origin()[1]);
+        const __m256d oz = _mm256_set1_pd(r.origin()[2]);
+        const __m256d dx = _mm256_set1_pd(r.direction()[0]);
+        const __m256d dy = _mm256_set1_pd(r.direction()[1]);
+        const __m256d dz = _mm256_set1_pd(r.direction()[2]);
+        const __m256d a = _mm256_set1_pd(r.direction().length_squared());
+        const __m256d tmin = _mm256_set1_pd(t_min);
+        const __m256d zero = _mm256_setzero_pd();
+        for(; k+4 <= end; k += 4){
+            __m256d ocx = _mm256_sub_pd(_mm256_loadu_pd(&center_x[k]), ox);
+            __m256d ocy = _mm256_sub_pd(_mm256_loadu_pd(&center_y[k]), oy);
+            __m256d ocz = _mm256_sub_pd(_mm256_loadu_pd(&center_z[k]), oz);
+            __m256d rad = _mm256_loadu_pd(&radius[k]);
+            __m256d h = _mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(dx, ocx), _mm256_mul_pd(dy, ocy)), _mm256_mul_pd(dz, ocz));
+            __m256d oc2 = _mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(ocx, ocx), _mm256_mul_pd(ocy, ocy)), _mm256_mul_pd(ocz, ocz));
+            __m256d c = _mm256_sub_pd(oc2, _mm256_mul_pd(rad, rad));
+            __m256d disc = _mm256_sub_pd(_mm256_mul_pd(h, h), _mm256_mul_pd(a, c));
+            __m256d valid = _mm256_cmp_pd(disc, zero, _CMP_GE_OQ);
+            if(_mm256_movemask_pd(valid) == 0){
+                continue;
+            }
+            __m256d sq = _mm256_sqrt_pd(_mm256_max_pd(disc, zero));
+            __m256d tmax = _mm256_set1_pd(closest);
+            __m256d t1 = _mm256_div_pd(_mm256_sub_pd(h, sq), a);
+            __m256d t2 = _mm256_div_pd(_mm256_add_pd(h, sq), a);
+            __m256d ok1 = _mm256_and_pd(_mm256_cmp_pd(t1, tmin, _CMP_GE_OQ), _mm256_cmp_pd(t1, tmax, _CMP_LE_OQ));
+            __m256d ok2 = _mm256_and_pd(_mm256_cmp_pd(t2, tmin, _CMP_GE_OQ), _mm256_cmp_pd(t2, tmax, _CMP_LE_OQ));
+            __m256d t = _mm256_blendv_pd(t2, t1, ok1);
+            int mask = _mm256_movemask_pd(_mm256_and_pd(valid, _mm256_or_pd(ok1, ok2)));
+            if(mask == 0){
+                continue;
+            }
+            alignas(32) double ts[4];
+            _mm256_store_pd(ts, t);
+            for(int lane=0; lane<4; lane++){
+                if((mask >> lane) & 1 && ts[lane] <= closest){
+                    closest = ts[lane];
+                    best = long(k) + lane;
+                }
+            }
+        }
+#elif defined(SPHERE_SET_SSE2)
+        const __m128d ox = _mm_set1_pd(r.origin()[0]);
+        const __m128d oy = _mm_set1_pd(r.origin()[1]);
+        const __m128d oz = _mm_set1_pd(r.origin()[2]);
+        const __m128d dx = _mm_set1_pd(r.direction()[0]);
+        const __m128d dy = _mm_set1_pd(r.direction()[1]);
+        const __m128d dz = _mm_set1_pd(r.direction()[2]);
+        const __m128d a = _mm_set1_pd(r.direction().length_squared());
+        const __m128d tmin = _mm_set1_pd(t_min);
+        const __m128d zero = _mm_setzero_pd();
+        for(; k+2 <= end; k += 2){
+            __m128d ocx = _mm_sub_pd(_mm_loadu_pd(&center_x[k]), ox);
+            __m128d ocy = _mm_sub_pd(_mm_loadu_pd(&center_y[k]), oy);
+            __m128d ocz = _mm_sub_pd(_mm_loadu_pd(&center_z[k]), oz);
+            __m128d rad = _mm_loadu_pd(&radius[k]);
+            __m128d h = _mm_add_pd(_mm_add_pd(_mm_mul_pd(dx, ocx), _mm_mul_pd(dy, ocy)), _mm_mul_pd(dz, ocz));
+            __m128d oc2 = _mm_add_pd(_mm_add_pd(_mm_mul_pd(ocx, ocx), _mm_mul_pd(ocy, ocy)), _mm_mul_pd(ocz, ocz));
+            __m128d c = _mm_sub_pd(oc2, _mm_mul_pd(rad, rad));
+            __m128d disc = _mm_sub_pd(_mm_mul_pd(h, h), _mm_mul_pd(a, c));
+            __m128d valid = _mm_cmpge_pd(disc, zero);
+            if(_mm_movemask_pd(valid) == 0){
+                continue;
+            }
+            __m128d sq = _mm_sqrt_pd(_mm_max_pd(disc, zero));
+            __m128d tmax = _mm_set1_pd(closest);
+            __m128d t1 = _mm_div_pd(_mm_sub_pd(h, sq), a);
+            __m128d t2 = _mm_div_pd(_mm_add_pd(h, sq), a);
+            __m128d ok1 = _mm_and_pd(_mm_cmpge_pd(t1, tmin), _mm_cmple_pd(t1, tmax));
+            __m128d ok2 = _mm_and_pd(_mm_cmpge_pd(t2, tmin), _mm_cmple_pd(t2, tmax));
+            __m128d t = _mm_or_pd(_mm_and_pd(ok1, t1), _mm_andnot_pd(ok1, t2));
+            int mask = _mm_movemask_pd(_mm_and_pd(valid, _mm_or_pd(ok1, ok2)));
+            if(mask == 0){
+                continue;
+            }
+            alignas(16) double ts[2];
+            _mm_store_pd(ts, t);
+            for(int lane=0; lane<2; lane++){
+                if((mask >> lane) & 1 && ts[lane] <= closest){
+                    closest = ts[lane];
+                    best = long(k) + lane;
+                }
+            }
+        }
+#endif
+        // Scalar loop for the whole range without SIMD, or the leftover spheres with it //
+        for(; k<end; k++){
+            double t;
+            if(hit_one(k, r, t_min, closest, t)){
+                closest = t;
+                best = long(k);
+            }
+        }
+        return best;
+    }
+
+    public:
+    // Name of the kernel compiled in, for benchmarks and logs //
+    static const char* kernel_name(){
+#if defined(SPHERE_SET_AVX2)
+        return "avx2";
+#elif defined(SPHERE_SET_SSE2)
+        return "sse2";
+#else
+        return "scalar";
+#endif
+    }
+
+    size_t size() const{
+        return radius.size();
+    }
+
+    void add(const Point3& center, real r, Material_id mat){
+        center_x.vector().push_back(center[0]);
+        center_y.vector().push_back(center[1]);
+        center_z.vector().push_back(center[2]);
+        radius.vector().push_back(std::fmax(0, r));
+        material.vector().push_back(mat);
+        bbox = Aabb(bbox, sphere_box(radius.size()-1));
+        built = false;
+    }
+
+    // Build a hierarchy whose leaves are runs of adjacent spheres tested together by the kernel. //
+    // Without it hit() scans every sphere, which is only worth it for small sets. //
+    void build(int max_leaf_size = 8){
+        std::vector<Aabb> boxes(size());
+        for(size_t k=0; k<size(); k++){
+            boxes[k] = sphere_box(k);
+        }
+        bvh = Flat_bvh(boxes, max_leaf_size);
+
+        apply_order(center_x, bvh.order());
+        apply_order(center_y, bvh.order());
+        apply_order(center_z, bvh.order());
+        apply_order(radius, bvh.order());
+        apply_order(material, bvh.order());
+        built = true;
+    }
+
+    // Arrays of the set for writing it out, build() it first //
+    Sphere_set_arrays arrays() const{
+        Sphere_set_arrays a;
+        a.count = size();
+        a.center_x = center_x.data();
+        a.center_y = center_y.data();
+        a.center_z = center_z.data();
+        a.radius = radius.data();
+        a.material = material.data();
+        a.node_count = bvh.node_array().size();
+        a.nodes = bvh.node_array().data();
+        a.bbox = bbox;
+        return a;
+    }
+
+    // Use arrays stored elsewhere, e.g. in a mapped scene file, without copying them. //
+    // owner keeps them alive; adding spheres afterwards copies them into the set. //
+    void attach(const Sphere_set_arrays& a, std::shared_ptr<const void> owner){
+        center_x = Buffer<double>::view(a.center_x, a.count, owner);
+        center_y = Buffer<double>::view(a.center_y, a.count, owner);
+        center_z = Buffer<double>::view(a.center_z, a.count, owner);
+        radius = Buffer<double>::view(a.radius, a.count, owner);
+        material = Buffer<Material_id>::view(a.material, a.count, owner);
+        bvh = Flat_bvh::view(a.nodes, a.node_count, owner);
+        bbox = a.bbox;
+        built = a.node_count > 0;
+    }
+
+    bool hit(const Ray& r, Interval ray_t, Hit_record& rec) const override{
+        long best = -1;
+        double best_t = ray_t.max;
+        if(built){
+            bvh.traverse_leaves(r, ray_t, [&](std::uint32_t first, std::uint32_t count, real& closest){
+                double leaf_closest = closest;
+                long k = closest_in_range(first, count, r, ray_t.min, leaf_closest);
+                if(k < 0){
+                    return false;
+                }
+                best = k;
+                best_t = leaf_closest;
+                closest = real(leaf_closest);
+                return true;
+            });
+        }else{
+            RT_STAT_ADD(Stat::primitive_tests, size());
+            best = closest_in_range(0, size(), r, ray_t.min, best_t);
+        }
+        if(best < 0){
+            return false;
+        }
+
+        // Fill the record once for the winning sphere //
+        auto center = Point3(center_x[best], center_y[best], center_z[best]);
+        rec.t = best_t;
+        rec.P = r.at(best_t);
+        Vec3 outward_normal = (rec.P - center) / radius[best];
+        rec.set_face_normal(r, outward_normal);
+        rec.mat = material[best];
+        return true;
+    }
+
+    bool uses_marked_material(const std::vector<char>& marked) const override{
+        for(size_t k=0; k<material.size(); k++){
+            if(is_marked(marked, material[k])){
+                return true;
+            }
+        }
+        return false;
+    }
+
+    Aabb bounding_box() const override{
+        return bbox;
+    }
+};
+
+#endif
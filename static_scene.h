@@ -0,0 +1,238 @@
+#ifndef STATIC_SCENE_H
+#define STATIC_SCENE_H
+
+#include "aabb.h"
+#include "bvh.h"
+#include "color.h"
+#include "hittable.h"
+#include "instance.h"
+#include "interval.h"
+#include "lights.h"
+#include "material.h"
+#include "quad.h"
+#include "ray.h"
+#include "ray_packet.h"
+#include "sphere.h"
+#include "transform.h"
+#include "triangle_mesh.h"
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <typeindex>
+#include <typeinfo>
+#include <variant>
+#include <vector>
+
+// Scene whose shape and material types are fixed at compile time and stored by value. Hits walk a //
+// Flat_bvh straight into Sphere::hit and scattering visits a std::variant, so the hot path has no //
+// virtual call and the compiler can inline both. Same functions for the Camera as Scene. //
+class Static_scene{
+    private:
+    std::vector<Sphere> spheres; //in leaf order once built//
+    std::vector<Quad> quads; //in leaf order of quad_bvh once built//
+    std::vector<Material_variant> materials;
+    std::vector<Instance_of<Triangle_mesh>> instances; //placed meshes, in leaf order of instance_bvh once built//
+    Flat_bvh bvh;
+    Flat_bvh quad_bvh;
+    Flat_bvh instance_bvh; //top level over the instances, each mesh has its own hierarchy below//
+    std::vector<std::uint32_t> instance_slot; //where the instance added k-th sits in instances//
+    Light_list light_list; //spheres and quads of emitting materials//
+
+    Color3 emission(Material_id mat) const{
+        return std::visit([](const auto& m){ return m.emission(); }, materials[mat]);
+    }
+
+    // Materials that emit light, marked by Material_id //
+    std::vector<char> emitting_materials() const{
+        std::vector<char> marked(materials.size());
+        for(size_t k=0; k<materials.size(); k++){
+            Color3 light = emission(Material_id(k));
+            marked[k] = light[0] > 0 || light[1] > 0 || light[2] > 0;
+        }
+        return marked;
+    }
+
+    // Hierarchy over shapes, and the shapes put in its leaf order //
+    template <typename Shape>
+    static Flat_bvh build_shapes(std::vector<Shape>& shapes, int max_leaf_size){
+        std::vector<Aabb> boxes;
+        boxes.reserve(shapes.size());
+        for(const auto& shape : shapes){
+            boxes.push_back(shape.bounding_box());
+        }
+        Flat_bvh bvh(boxes, max_leaf_size);
+
+        std::vector<Shape> sorted;
+        sorted.reserve(shapes.size());
+        for(auto index : bvh.order()){
+            sorted.push_back(shapes[index]);
+        }
+        shapes.swap(sorted);
+        return bvh;
+    }
+
+    public:
+    Material_id add_material(const Material_variant& mat){
+        materials.push_back(mat);
+        return Material_id(materials.size() - 1);
+    }
+
+    void add_sphere(const Point3& center, real radius, Material_id mat){
+        spheres.emplace_back(center, radius, mat);
+        light_list.add_sphere(center, radius, emission(mat));
+    }
+
+    void add_quad(const Point3& corner, const Vec3& u, const Vec3& v, Material_id mat){
+        quads.emplace_back(corner, u, v, mat);
+        light_list.add_quad(corner, u, v, emission(mat));
+    }
+
+    bool add_mesh(shared_ptr<const Triangle_mesh> mesh){
+        return add_instance(mesh, Transform());
+    }
+
+    // Place a built mesh, shared with any other instances of it. mat replaces the mesh's material. //
+    // False, adding nothing, when the material emits: only spheres and quads are sampled as lights. //
+    bool add_instance(shared_ptr<const Triangle_mesh> mesh, const Transform& to_world,
+                      Material_id mat = Instance_of<Triangle_mesh>::keep_material){
+        Instance_of<Triangle_mesh> instance(mesh, to_world, mat);
+        if(instance.uses_marked_material(emitting_materials())){
+            return false;
+        }
+        instances.push_back(instance);
+        instance_slot.push_back(std::uint32_t(instances.size() - 1));
+        return true;
+    }
+
+    size_t instance_count() const{
+        return instances.size();
+    }
+
+    // Move the index-th instance added; refit() before rendering again //
+    void set_instance_transform(size_t index, const Transform& to_world){
+        instances[instance_slot[index]].set_transform(to_world);
+    }
+
+    // Update the instance hierarchy after instances moved, keeping its tree. Cheaper than build(), //
+    // though the tree gets looser the further instances travel from where it was built. //
+    void refit(){
+        std::vector<Aabb> boxes;
+        boxes.reserve(instances.size());
+        for(const auto& instance : instances){
+            boxes.push_back(instance.bounding_box());
+        }
+        instance_bvh.refit(boxes);
+    }
+
+    // Build the hierarchies over the spheres, quads and instances, needed before rendering and //
+    // after adding more //
+    void build(int max_leaf_size = 4){
+        bvh = build_shapes(spheres, max_leaf_size);
+        quad_bvh = build_shapes(quads, max_leaf_size);
+
+        std::vector<Aabb> boxes;
+        for(const auto& instance : instances){
+            boxes.push_back(instance.bounding_box());
+        }
+        instance_bvh = Flat_bvh(boxes, 1);
+        std::vector<Instance_of<Triangle_mesh>> sorted_instances;
+        std::vector<std::uint32_t> position(instances.size());
+        sorted_instances.reserve(instances.size());
+        for(auto index : instance_bvh.order()){
+            position[index] = std::uint32_t(sorted_instances.size());
+            sorted_instances.push_back(instances[index]);
+        }
+        instances.swap(sorted_instances);
+        for(auto& slot : instance_slot){
+            slot = position[slot];
+        }
+    }
+
+    size_t size() const{
+        return spheres.size();
+    }
+
+    bool hit(const Ray& r, Interval ray_t, Hit_record& rec) const{
+        bool hit_anything = bvh.traverse(r, ray_t, [&](std::uint32_t k, real& closest){
+            if(spheres[k].hit(r, Interval(ray_t.min, closest), rec)){
+                closest = rec.t;
+                return true;
+            }
+            return false;
+        });
+        // Quad, Instance_of and Triangle_mesh are final, so these calls are direct too //
+        Interval quad_t(ray_t.min, hit_anything ? rec.t : ray_t.max);
+        hit_anything |= quad_bvh.traverse(r, quad_t, [&](std::uint32_t k, real& closest){
+            if(quads[k].hit(r, Interval(ray_t.min, closest), rec)){
+                closest = rec.t;
+                return true;
+            }
+            return false;
+        });
+        Interval instance_t(ray_t.min, hit_anything ? rec.t : ray_t.max);
+        hit_anything |= instance_bvh.traverse(r, instance_t, [&](std::uint32_t k, real& closest){
+            if(instances[k].hit(r, Interval(ray_t.min, closest), rec)){
+                closest = rec.t;
+                return true;
+            }
+            return false;
+        });
+        return hit_anything;
+    }
+
+    void hit_packet(const Ray_packet& rays, Packet_hit& hits) const{
+        bvh.traverse_packet_leaves(rays, hits, [&](std::uint32_t first, std::uint32_t count){
+            for(std::uint32_t k=first; k<first + count; k++){
+                spheres[k].hit_packet(rays, hits);
+            }
+        });
+        quad_bvh.traverse_packet_leaves(rays, hits, [&](std::uint32_t first, std::uint32_t count){
+            for(std::uint32_t k=first; k<first + count; k++){
+                quads[k].hit_packet(rays, hits);
+            }
+        });
+        instance_bvh.traverse_packet_leaves(rays, hits, [&](std::uint32_t first, std::uint32_t count){
+            for(std::uint32_t k=first; k<first + count; k++){
+                instances[k].hit_packet(rays, hits);
+            }
+        });
+    }
+
+    bool scatter(const Ray& ray_in, const Hit_record& rec, Color3& attenuation, Ray& scattered) const{
+        return std::visit([&](const auto& mat){
+            return mat.scatter(ray_in, rec, attenuation, scattered);
+        }, materials[rec.mat]);
+    }
+
+    Color3 base_color(const Hit_record& rec) const{
+        return std::visit([&](const auto& mat){
+            return mat.base_color(rec);
+        }, materials[rec.mat]);
+    }
+
+    Color3 emitted(const Hit_record& rec) const{
+        return std::visit([&](const auto& mat){
+            return mat.emitted(rec);
+        }, materials[rec.mat]);
+    }
+
+    bool evaluate(const Ray& ray_in, const Hit_record& rec, const Vec3& direction, Color3& f_cos, double& pdf) const{
+        return std::visit([&](const auto& mat){
+            return mat.evaluate(ray_in, rec, direction, f_cos, pdf);
+        }, materials[rec.mat]);
+    }
+
+    const Light_list& lights() const{
+        return light_list;
+    }
+
+    std::type_index material_type(Material_id mat) const{
+        return std::visit([](const auto& m) -> std::type_index { return typeid(m); }, materials[mat]);
+    }
+
+    size_t material_count() const{
+        return materials.size();
+    }
+};
+
+#endif
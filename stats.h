@@ -0,0 +1,308 @@
+#ifndef STATS_H
+#define STATS_H
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <typeindex>
+#include <vector>
+
+#if defined(__GNUG__)
+#include <cstdlib>
+#include <cxxabi.h>
+#endif
+
+// Render statistics: event counters and scoped timers kept per thread, so the hot path only bumps //
+// a thread local integer, and added up into a JSON report and a Chrome trace (chrome://tracing or //
+// ui.perfetto.dev) once rendering is done. Everything is compiled in with RT_ENABLE_STATS only //
+// (cmake -DRT_ENABLE_STATS=ON); otherwise the RT_STAT macros expand to nothing and the report //
+// functions just say the build has no statistics. //
+
+enum class Stat : int{
+    camera_rays,        //rays leaving the camera, one per path//
+    secondary_rays,     //rays after a scatter//
+    shadow_rays,        //rays towards points picked on lights//
+    bvh_nodes,          //hierarchy nodes whose box was tested//
+    primitive_tests,    //primitives tested in hierarchy leaves//
+    roulette_ended,     //paths ended by Russian roulette//
+    depth_limited,      //paths cut off at the camera's max_depth//
+    count
+};
+
+inline const char* stat_name(Stat stat){
+    static const char* names[] = {"camera_rays", "secondary_rays", "shadow_rays", "bvh_nodes", "primitive_tests",
+                                  "roulette_ended", "depth_limited"};
+    return names[int(stat)];
+}
+
+// Readable name of a type for reports //
+inline std::string type_name(const std::type_index& type){
+#if defined(__GNUG__)
+    int status = 0;
+    char* demangled = abi::__cxa_demangle(type.name(), nullptr, nullptr, &status);
+    if(status == 0 && demangled){
+        std::string name = demangled;
+        std::free(demangled);
+        return name;
+    }
+#endif
+    return type.name();
+}
+
+// Type names of a scene's materials by id, for the scatter calls of the report //
+template <typename Scene_type>
+std::vector<std::string> material_type_names(const Scene_type& scene){
+    std::vector<std::string> names;
+    for(size_t k=0; k<scene.material_count(); k++){
+        names.push_back(type_name(scene.material_type(std::uint32_t(k))));
+    }
+    return names;
+}
+
+#ifdef RT_ENABLE_STATS
+
+// One completed scoped timer, times in microseconds since the statistics started //
+struct Stat_event{
+    const char* name;
+    double start;
+    double duration;
+};
+
+struct Thread_stats{
+    static constexpr size_t max_events = size_t(1) << 20; //later timers are not recorded//
+    int thread = 0;
+    std::uint64_t counters[int(Stat::count)] = {};
+    std::vector<std::uint64_t> scatters; //by material id//
+    std::vector<std::uint64_t> path_depths; //paths by the number of rays they traced//
+    std::vector<Stat_event> events;
+
+    void add_scatter(std::uint32_t mat){
+        if(mat >= scatters.size()){
+            scatters.resize(mat + 1, 0);
+        }
+        scatters[mat]++;
+    }
+
+    void add_path_depth(std::uint32_t rays){
+        if(rays >= path_depths.size()){
+            path_depths.resize(rays + 1, 0);
+        }
+        path_depths[rays]++;
+    }
+};
+
+// Every thread's statistics, kept after the thread ends so the report still sees its work //
+class Stats_registry{
+    private:
+    std::mutex lock;
+
+    public:
+    std::vector<std::unique_ptr<Thread_stats>> threads;
+    std::chrono::steady_clock::time_point epoch = std::chrono::steady_clock::now();
+
+    Thread_stats* add(){
+        std::lock_guard<std::mutex> guard(lock);
+        threads.push_back(std::make_unique<Thread_stats>());
+        threads.back()->thread = int(threads.size() - 1);
+        return threads.back().get();
+    }
+
+    double now() const{
+        return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - epoch).count();
+    }
+};
+
+inline Stats_registry& stats_registry(){
+    static Stats_registry registry;
+    return registry;
+}
+
+inline Thread_stats& thread_stats(){
+    thread_local Thread_stats* stats = stats_registry().add();
+    return *stats;
+}
+
+// Records the time from construction to destruction as an event of the calling thread //
+class Stat_timer{
+    private:
+    const char* name;
+    double start;
+
+    public:
+    explicit Stat_timer(const char* name) : name(name), start(stats_registry().now()) {}
+    Stat_timer(const Stat_timer&) = delete;
+    Stat_timer& operator=(const Stat_timer&) = delete;
+
+    ~Stat_timer(){
+        auto& stats = thread_stats();
+        double end = stats_registry().now();
+        if(stats.events.size() < Thread_stats::max_events){
+            stats.events.push_back({name, start, end - start});
+        }
+    }
+};
+
+#define RT_STAT_CONCAT_(a, b) a##b
+#define RT_STAT_CONCAT(a, b) RT_STAT_CONCAT_(a, b)
+#define RT_STAT_ADD(stat, n) (thread_stats().counters[int(stat)] += std::uint64_t(n))
+#define RT_STAT_SCATTER(mat) thread_stats().add_scatter(std::uint32_t(mat))
+#define RT_STAT_PATH_DEPTH(rays) thread_stats().add_path_depth(std::uint32_t(rays))
+#define RT_STAT_TIMER(name) Stat_timer RT_STAT_CONCAT(rt_stat_timer_, __LINE__)(name)
+
+inline constexpr bool stats_enabled(){
+    return true;
+}
+
+inline void append_json_string(std::string& out, const std::string& text){
+    out += '"';
+    for(char c : text){
+        if(c == '"' || c == '\\'){
+            out += '\\';
+        }
+        out += c;
+    }
+    out += '"';
+}
+
+// JSON report of everything counted so far. material_types names the type of each material id, //
+// scatter calls are summed per type. //
+inline std::string stats_json(const std::vector<std::string>& material_types){
+    auto& registry = stats_registry();
+    std::uint64_t totals[int(Stat::count)] = {};
+    std::vector<std::pair<std::string, std::uint64_t>> scatters;
+    std::vector<std::uint64_t> path_depths;
+    std::vector<std::pair<std::string, std::pair<double, std::uint64_t>>> timers;
+    for(const auto& stats : registry.threads){
+        for(int k=0; k<int(Stat::count); k++){
+            totals[k] += stats->counters[k];
+        }
+        for(size_t mat=0; mat<stats->scatters.size(); mat++){
+            std::string type = mat < material_types.size() ? material_types[mat] : "material " + std::to_string(mat);
+            size_t k = 0;
+            while(k < scatters.size() && scatters[k].first != type) k++;
+            if(k == scatters.size()) scatters.push_back({type, 0});
+            scatters[k].second += stats->scatters[mat];
+        }
+        if(stats->path_depths.size() > path_depths.size()){
+            path_depths.resize(stats->path_depths.size(), 0);
+        }
+        for(size_t depth=0; depth<stats->path_depths.size(); depth++){
+            path_depths[depth] += stats->path_depths[depth];
+        }
+        for(const auto& event : stats->events){
+            size_t k = 0;
+            while(k < timers.size() && timers[k].first != event.name) k++;
+            if(k == timers.size()) timers.push_back({event.name, {0.0, 0}});
+            timers[k].second.first += event.duration;
+            timers[k].second.second++;
+        }
+    }
+
+    auto number = [](double value){
+        char text[32];
+        std::snprintf(text, sizeof(text), "%.6g", value);
+        return std::string(text);
+    };
+    std::uint64_t camera = totals[int(Stat::camera_rays)];
+    std::uint64_t path_rays = camera + totals[int(Stat::secondary_rays)];
+    std::uint64_t rays = path_rays + totals[int(Stat::shadow_rays)];
+    std::string out = "{\n  \"counters\": {";
+    for(int k=0; k<int(Stat::count); k++){
+        out += k ? ",\n    " : "\n    ";
+        append_json_string(out, stat_name(Stat(k)));
+        out += ": " + std::to_string(totals[k]);
+    }
+    out += "\n  },\n  \"derived\": {";
+    out += "\n    \"rays\": " + std::to_string(rays);
+    out += ",\n    \"primitive_tests_per_ray\": " + number(rays ? double(totals[int(Stat::primitive_tests)]) / rays : 0);
+    out += ",\n    \"bvh_nodes_per_ray\": " + number(rays ? double(totals[int(Stat::bvh_nodes)]) / rays : 0);
+    out += ",\n    \"average_path_depth\": " + number(camera ? double(path_rays) / camera : 0);
+    out += "\n  },\n  \"scatter_calls\": {";
+    for(size_t k=0; k<scatters.size(); k++){
+        out += k ? ",\n    " : "\n    ";
+        append_json_string(out, scatters[k].first);
+        out += ": " + std::to_string(scatters[k].second);
+    }
+    // Entry k counts the paths that traced k rays, the camera ray included //
+    out += "\n  },\n  \"path_depths\": [";
+    for(size_t k=0; k<path_depths.size(); k++){
+        out += k ? ", " : "";
+        out += std::to_string(path_depths[k]);
+    }
+    out += "],\n  \"timers\": {";
+    for(size_t k=0; k<timers.size(); k++){
+        out += k ? ",\n    " : "\n    ";
+        append_json_string(out, timers[k].first);
+        out += ": {\"calls\": " + std::to_string(timers[k].second.second)
+             + ", \"total_ms\": " + number(timers[k].second.first / 1000) + "}";
+    }
+    out += "\n  },\n  \"threads\": " + std::to_string(registry.threads.size()) + "\n}\n";
+    return out;
+}
+
+// Chrome trace event format, one complete event per recorded timer //
+inline std::string stats_trace(){
+    std::string out = "{\"traceEvents\": [";
+    bool first = true;
+    char line[256];
+    for(const auto& stats : stats_registry().threads){
+        for(const auto& event : stats->events){
+            std::snprintf(line, sizeof(line), "%s\n{\"ph\": \"X\", \"pid\": 1, \"tid\": %d, \"ts\": %.3f, \"dur\": %.3f, \"name\": ",
+                          first ? "" : ",", stats->thread, event.start, event.duration);
+            out += line;
+            append_json_string(out, event.name);
+            out += '}';
+            first = false;
+        }
+    }
+    out += "\n]}\n";
+    return out;
+}
+
+inline bool write_stats_file(const std::string& path, const std::string& text, std::string& error){
+    std::FILE* file = std::fopen(path.c_str(), "wb");
+    bool ok = file && std::fwrite(text.data(), 1, text.size(), file) == text.size();
+    if(file && std::fclose(file) != 0){
+        ok = false;
+    }
+    if(!ok){
+        error = "cannot write " + path;
+    }
+    return ok;
+}
+
+inline bool write_stats_report(const std::string& path, const std::vector<std::string>& material_types, std::string& error){
+    return write_stats_file(path, stats_json(material_types), error);
+}
+
+inline bool write_stats_trace(const std::string& path, std::string& error){
+    return write_stats_file(path, stats_trace(), error);
+}
+
+#else
+
+#define RT_STAT_ADD(stat, n) ((void)0)
+#define RT_STAT_SCATTER(mat) ((void)0)
+#define RT_STAT_PATH_DEPTH(rays) ((void)0)
+#define RT_STAT_TIMER(name) ((void)0)
+
+inline constexpr bool stats_enabled(){
+    return false;
+}
+
+inline bool write_stats_report(const std::string&, const std::vector<std::string>&, std::string& error){
+    error = "statistics are not compiled in, build with RT_ENABLE_STATS";
+    return false;
+}
+
+inline bool write_stats_trace(const std::string&, std::string& error){
+    error = "statistics are not compiled in, build with RT_ENABLE_STATS";
+    return false;
+}
+
+#endif
+
+#endif
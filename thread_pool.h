@@ -0,0 +1,159 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Double ended queue of task indices owned by one worker. The owner pops from the front, //
+// idle workers steal from the back so they take the work furthest from what the owner is doing. //
+class Task_queue{
+    private:
+    std::mutex lock;
+    std::deque<int> tasks;
+
+    public:
+    void push(int task){
+        std::lock_guard<std::mutex> guard(lock);
+        tasks.push_back(task);
+    }
+
+    bool pop(int& task){
+        std::lock_guard<std::mutex> guard(lock);
+        if(tasks.empty()){
+            return false;
+        }
+        task = tasks.front();
+        tasks.pop_front();
+        return true;
+    }
+
+    bool steal(int& task){
+        std::lock_guard<std::mutex> guard(lock);
+        if(tasks.empty()){
+            return false;
+        }
+        task = tasks.back();
+        tasks.pop_back();
+        return true;
+    }
+};
+
+// Persistent pool of worker threads running indexed tasks with work stealing. //
+// The thread calling run() takes part as worker 0, so a pool of size 1 spawns no threads. //
+class Thread_pool{
+    private:
+    using Job = std::function<void(int task, int thread)>;
+
+    std::vector<std::thread> workers;
+    std::vector<Task_queue> queues;
+    std::mutex job_lock;
+    std::condition_variable job_ready;
+    std::condition_variable job_finished;
+    const Job* job = nullptr;
+    long long generation = 0;
+    int busy_workers = 0;
+    bool stopping = false;
+
+    void execute(int thread){
+        int task;
+        int count = int(queues.size());
+        while(true){
+            if(!queues[thread].pop(task)){
+                bool stolen = false;
+                for(int k=1; k<count && !stolen; k++){
+                    stolen = queues[(thread+k) % count].steal(task);
+                }
+                // Tasks are only queued before a job starts, so empty queues mean we are done //
+                if(!stolen){
+                    return;
+                }
+            }
+            (*job)(task, thread);
+        }
+    }
+
+    void worker_loop(int thread){
+        long long seen = 0;
+        while(true){
+            {
+                std::unique_lock<std::mutex> guard(job_lock);
+                job_ready.wait(guard, [&]{ return stopping || generation != seen; });
+                if(stopping){
+                    return;
+                }
+                seen = generation;
+            }
+            execute(thread);
+            {
+                std::lock_guard<std::mutex> guard(job_lock);
+                if(--busy_workers == 0){
+                    job_finished.notify_one();
+                }
+            }
+        }
+    }
+
+    public:
+    explicit Thread_pool(int thread_count) : queues(std::max(1, thread_count)) {
+        for(int t=1; t<int(queues.size()); t++){
+            workers.emplace_back([this, t]{ worker_loop(t); });
+        }
+    }
+
+    ~Thread_pool(){
+        {
+            std::lock_guard<std::mutex> guard(job_lock);
+            stopping = true;
+        }
+        job_ready.notify_all();
+        for(auto& worker : workers){
+            worker.join();
+        }
+    }
+
+    Thread_pool(const Thread_pool&) = delete;
+    Thread_pool& operator=(const Thread_pool&) = delete;
+
+    int size() const{
+        return int(queues.size());
+    }
+
+    // Run fn(task, thread) for every task in [0, task_count) and return once all have finished. //
+    // Each worker starts with a contiguous block of tasks so neighbouring tiles stay on one core. //
+    void run(int task_count, const Job& fn){
+        int count = size();
+        for(int t=0; t<count; t++){
+            int first = int((long long)task_count * t / count);
+            int last = int((long long)task_count * (t+1) / count);
+            for(int task=first; task<last; task++){
+                queues[t].push(task);
+            }
+        }
+
+        {
+            std::lock_guard<std::mutex> guard(job_lock);
+            job = &fn;
+            busy_workers = count - 1;
+            generation++;
+        }
+        job_ready.notify_all();
+
+        execute(0);
+
+        std::unique_lock<std::mutex> guard(job_lock);
+        job_finished.wait(guard, [&]{ return busy_workers == 0; });
+        job = nullptr;
+    }
+
+    static int default_thread_count(){
+        unsigned int n = std::thread::hardware_concurrency();
+        return n == 0 ? 1 : int(n);
+    }
+};
+
+#endif
@@ -0,0 +1,179 @@
+#ifndef TRANSFORM_H
+#define TRANSFORM_H
+
+#include "aabb.h"
+#include "interval.h"
+#include "rtweekend.h"
+#include "vec3.h"
+#include <cmath>
+
+// Affine transform from object to world space, a 3x4 matrix kept together with its inverse so //
+// rays can be taken into object space and hits brought back without inverting per query. //
+class Transform{
+    private:
+    double m[3][4]; //object to world, last column is the translation//
+    double inv[3][4]; //world to object//
+
+    static void multiply(const double a[3][4], const double b[3][4], double out[3][4]){
+        for(int i=0; i<3; i++){
+            for(int j=0; j<4; j++){
+                out[i][j] = a[i][0]*b[0][j] + a[i][1]*b[1][j] + a[i][2]*b[2][j] + (j == 3 ? a[i][3] : 0);
+            }
+        }
+    }
+
+    static Vec3 apply_linear(const double a[3][4], const Vec3& v){
+        return Vec3(a[0][0]*v[0] + a[0][1]*v[1] + a[0][2]*v[2],
+                    a[1][0]*v[0] + a[1][1]*v[1] + a[1][2]*v[2],
+                    a[2][0]*v[0] + a[2][1]*v[1] + a[2][2]*v[2]);
+    }
+
+    static Point3 apply_point(const double a[3][4], const Point3& p){
+        return apply_linear(a, p) + Vec3(a[0][3], a[1][3], a[2][3]);
+    }
+
+    public:
+    Transform(){
+        for(int i=0; i<3; i++){
+            for(int j=0; j<4; j++){
+                m[i][j] = inv[i][j] = i == j ? 1 : 0;
+            }
+        }
+    }
+
+    // General affine matrix given by rows, false in ok when it cannot be inverted //
+    static Transform matrix(const double rows[3][4], bool& ok){
+        Transform t;
+        const double (*a)[4] = rows;
+        double det = a[0][0]*(a[1][1]*a[2][2] - a[1][2]*a[2][1])
+                   - a[0][1]*(a[1][0]*a[2][2] - a[1][2]*a[2][0])
+                   + a[0][2]*(a[1][0]*a[2][1] - a[1][1]*a[2][0]);
+        ok = det != 0 && std::isfinite(det);
+        if(!ok){
+            return t;
+        }
+        double c[3][3] = {
+            {a[1][1]*a[2][2] - a[1][2]*a[2][1], a[0][2]*a[2][1] - a[0][1]*a[2][2], a[0][1]*a[1][2] - a[0][2]*a[1][1]},
+            {a[1][2]*a[2][0] - a[1][0]*a[2][2], a[0][0]*a[2][2] - a[0][2]*a[2][0], a[0][2]*a[1][0] - a[0][0]*a[1][2]},
+            {a[1][0]*a[2][1] - a[1][1]*a[2][0], a[0][1]*a[2][0] - a[0][0]*a[2][1], a[0][0]*a[1][1] - a[0][1]*a[1][0]}
+        };
+        for(int i=0; i<3; i++){
+            for(int j=0; j<4; j++){
+                t.m[i][j] = a[i][j];
+            }
+            for(int j=0; j<3; j++){
+                t.inv[i][j] = c[i][j] / det;
+            }
+        }
+        // Inverse translation is -A^-1 t //
+        for(int i=0; i<3; i++){
+            t.inv[i][3] = -(t.inv[i][0]*a[0][3] + t.inv[i][1]*a[1][3] + t.inv[i][2]*a[2][3]);
+        }
+        return t;
+    }
+
+    static Transform translate(const Vec3& offset){
+        Transform t;
+        for(int i=0; i<3; i++){
+            t.m[i][3] = offset[i];
+            t.inv[i][3] = -offset[i];
+        }
+        return t;
+    }
+
+    // Scale along each axis, no factor may be zero //
+    static Transform scale(const Vec3& factors){
+        Transform t;
+        for(int i=0; i<3; i++){
+            t.m[i][i] = factors[i];
+            t.inv[i][i] = 1 / double(factors[i]);
+        }
+        return t;
+    }
+
+    // Rotation by degrees counterclockwise about axis 0, 1 or 2 (x, y, z) looking down the axis //
+    static Transform rotate(int axis, double degrees){
+        Transform t;
+        double radians = degrees_to_radians(degrees);
+        double c = std::cos(radians), s = std::sin(radians);
+        int u = (axis + 1) % 3, v = (axis + 2) % 3;
+        t.m[u][u] = c;  t.m[u][v] = -s;
+        t.m[v][u] = s;  t.m[v][v] = c;
+        t.inv[u][u] = c;  t.inv[u][v] = s;
+        t.inv[v][u] = -s; t.inv[v][v] = c;
+        return t;
+    }
+
+    // a * b applies b first, then a //
+    friend Transform operator*(const Transform& a, const Transform& b){
+        Transform t;
+        multiply(a.m, b.m, t.m);
+        multiply(b.inv, a.inv, t.inv);
+        return t;
+    }
+
+    Point3 point(const Point3& p) const{
+        return apply_point(m, p);
+    }
+
+    Vec3 vector(const Vec3& v) const{
+        return apply_linear(m, v);
+    }
+
+    // Normals go through the inverse transpose so they stay perpendicular to the surface //
+    Vec3 normal(const Vec3& n) const{
+        return Vec3(inv[0][0]*n[0] + inv[1][0]*n[1] + inv[2][0]*n[2],
+                    inv[0][1]*n[0] + inv[1][1]*n[1] + inv[2][1]*n[2],
+                    inv[0][2]*n[0] + inv[1][2]*n[1] + inv[2][2]*n[2]);
+    }
+
+    Point3 inverse_point(const Point3& p) const{
+        return apply_point(inv, p);
+    }
+
+    Vec3 inverse_vector(const Vec3& v) const{
+        return apply_linear(inv, v);
+    }
+
+    // World box of an object space box, from the extent of each matrix column (Arvo's method) //
+    Aabb box(const Aabb& b) const{
+        if(b.is_empty()){
+            return b;
+        }
+        Interval axes[3];
+        for(int i=0; i<3; i++){
+            double lo = m[i][3], hi = m[i][3];
+            for(int j=0; j<3; j++){
+                const Interval& ax = b.axis_interval(j);
+                double e = m[i][j] * ax.min;
+                double f = m[i][j] * ax.max;
+                lo += std::fmin(e, f);
+                hi += std::fmax(e, f);
+            }
+            axes[i] = Interval(lo, hi);
+        }
+        return Aabb(axes[0], axes[1], axes[2]);
+    }
+
+    // The object to world matrix by rows //
+    void rows(double out[3][4]) const{
+        for(int i=0; i<3; i++){
+            for(int j=0; j<4; j++){
+                out[i][j] = m[i][j];
+            }
+        }
+    }
+
+    bool is_identity() const{
+        for(int i=0; i<3; i++){
+            for(int j=0; j<4; j++){
+                if(m[i][j] != (i == j ? 1 : 0)){
+                    return false;
+                }
+            }
+        }
+        return true;
+    }
+};
+
+#endif
@@ -0,0 +1,195 @@
+#ifndef TRIANGLE_MESH_H
+#define TRIANGLE_MESH_H
+
+#include "aabb.h"
+#include "bvh.h"
+#include "hittable.h"
+#include "interval.h"
+#include "ray.h"
+#include "ray_packet.h"
+#include "rtweekend.h"
+#include "vec3.h"
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+// Indexed triangle mesh: triangles refer to shared vertices by index, and a Flat_bvh over the //
+// triangles keeps intersection logarithmic in the triangle count. Like Sphere_set a hit only looks //
+// for the closest triangle and its barycentric coordinates, the record is filled once at the end. //
+class Triangle_mesh final : public Hittable{
+    private:
+    std::vector<Point3> positions;
+    std::vector<Vec3> normals; //per vertex shading normal, zero where none was given//
+    std::vector<std::uint32_t> indices; //three per triangle, in leaf order once built//
+    Material_id mat;
+    Flat_bvh bvh;
+    Aabb bbox;
+    bool has_normals = false;
+
+    Aabb triangle_box(size_t k) const{
+        const Point3& a = positions[indices[3*k]];
+        const Point3& b = positions[indices[3*k+1]];
+        const Point3& c = positions[indices[3*k+2]];
+        return Aabb(Aabb(a, b), Aabb(c, c));
+    }
+
+    // Moller-Trumbore test of triangle k. Edges are inclusive and only a zero determinant is //
+    // rejected, so a ray through a shared edge hits at least one of the two triangles. //
+    bool intersect(size_t k, const Point3& origin, const Vec3& direction, real t_min, real t_max,
+                   real& t, real& u, real& v) const{
+        const Point3& p0 = positions[indices[3*k]];
+        Vec3 e1 = positions[indices[3*k+1]] - p0;
+        Vec3 e2 = positions[indices[3*k+2]] - p0;
+        Vec3 pvec = cross(direction, e2);
+        real det = dot(e1, pvec);
+        if(det == 0){
+            return false;
+        }
+        real inv_det = 1 / det;
+        Vec3 tvec = origin - p0;
+        u = dot(tvec, pvec) * inv_det;
+        if(u < 0 || u > 1){
+            return false;
+        }
+        Vec3 qvec = cross(tvec, e1);
+        v = dot(direction, qvec) * inv_det;
+        if(v < 0 || u + v > 1){
+            return false;
+        }
+        t = dot(e2, qvec) * inv_det;
+        return t >= t_min && t <= t_max;
+    }
+
+    void fill_record(const Ray& r, size_t k, real t, real u, real v, Hit_record& rec) const{
+        std::uint32_t i0 = indices[3*k], i1 = indices[3*k+1], i2 = indices[3*k+2];
+        Vec3 geometric = unit_vector(cross(positions[i1] - positions[i0], positions[i2] - positions[i0]));
+        Vec3 outward_normal = geometric;
+        if(has_normals){
+            Vec3 shading = (1 - u - v) * normals[i0] + u * normals[i1] + v * normals[i2];
+            if(!shading.near_zero()){
+                // Keep the shading normal on the geometric side so front_face stays consistent //
+                shading = unit_vector(shading);
+                outward_normal = dot(shading, geometric) < 0 ? -shading : shading;
+            }
+        }
+        rec.t = t;
+        rec.P = r.at(t);
+        rec.set_face_normal(r, outward_normal);
+        rec.mat = mat;
+    }
+
+    public:
+    Triangle_mesh(Material_id mat = 0) : mat(mat) {}
+
+    std::uint32_t add_vertex(const Point3& p){
+        positions.push_back(p);
+        normals.push_back(Vec3(0, 0, 0));
+        return std::uint32_t(positions.size() - 1);
+    }
+
+    std::uint32_t add_vertex(const Point3& p, const Vec3& n){
+        positions.push_back(p);
+        normals.push_back(n);
+        has_normals = true;
+        return std::uint32_t(positions.size() - 1);
+    }
+
+    void add_triangle(std::uint32_t a, std::uint32_t b, std::uint32_t c){
+        indices.push_back(a);
+        indices.push_back(b);
+        indices.push_back(c);
+        bbox = Aabb(bbox, triangle_box(triangle_count() - 1));
+    }
+
+    void set_material(Material_id id){
+        mat = id;
+    }
+
+    size_t vertex_count() const{
+        return positions.size();
+    }
+
+    size_t triangle_count() const{
+        return indices.size() / 3;
+    }
+
+    // Build the hierarchy and put the triangles in its leaf order, needed before rendering //
+    void build(int max_leaf_size = 4){
+        std::vector<Aabb> boxes(triangle_count());
+        for(size_t k=0; k<boxes.size(); k++){
+            boxes[k] = triangle_box(k);
+        }
+        bvh = Flat_bvh(boxes, max_leaf_size);
+
+        std::vector<std::uint32_t> sorted(indices.size());
+        const auto& order = bvh.order();
+        for(size_t k=0; k<order.size(); k++){
+            for(int corner=0; corner<3; corner++){
+                sorted[3*k + corner] = indices[3*size_t(order[k]) + corner];
+            }
+        }
+        indices.swap(sorted);
+    }
+
+    bool hit(const Ray& r, Interval ray_t, Hit_record& rec) const override{
+        long best = -1;
+        real best_t = 0, best_u = 0, best_v = 0;
+        bvh.traverse(r, ray_t, [&](std::uint32_t k, real& closest){
+            real t, u, v;
+            if(!intersect(k, r.origin(), r.direction(), ray_t.min, closest, t, u, v)){
+                return false;
+            }
+            best = k;
+            best_t = t;
+            best_u = u;
+            best_v = v;
+            closest = t;
+            return true;
+        });
+        if(best < 0){
+            return false;
+        }
+        fill_record(r, size_t(best), best_t, best_u, best_v, rec);
+        return true;
+    }
+
+    void hit_packet(const Ray_packet& rays, Packet_hit& hits) const override{
+        long best[Ray_packet::size];
+        real best_u[Ray_packet::size], best_v[Ray_packet::size];
+        for(int lane=0; lane<Ray_packet::size; lane++){
+            best[lane] = -1;
+        }
+        bvh.traverse_packet_leaves(rays, hits, [&](std::uint32_t first, std::uint32_t count){
+            for(int lane=0; lane<rays.count; lane++){
+                Point3 origin(rays.ox[lane], rays.oy[lane], rays.oz[lane]);
+                Vec3 direction(rays.dx[lane], rays.dy[lane], rays.dz[lane]);
+                for(std::uint32_t k=first; k<first + count; k++){
+                    real t, u, v;
+                    if(intersect(k, origin, direction, hits.t_min, hits.closest[lane], t, u, v)){
+                        best[lane] = k;
+                        best_u[lane] = u;
+                        best_v[lane] = v;
+                        hits.closest[lane] = t;
+                    }
+                }
+            }
+        });
+        for(int lane=0; lane<rays.count; lane++){
+            if(best[lane] < 0){
+                continue;
+            }
+            fill_record(rays.ray(lane), size_t(best[lane]), hits.closest[lane], best_u[lane], best_v[lane], hits.rec[lane]);
+            hits.hit[lane] = true;
+        }
+    }
+
+    bool uses_marked_material(const std::vector<char>& marked) const override{
+        return is_marked(marked, mat);
+    }
+
+    Aabb bounding_box() const override{
+        return bbox;
+    }
+};
+
+#endif
@@ -2,152 +2,413 @@
 #define VEC3_H
 
 #include "rtweekend.h"
+#include <cstddef>
 #include <iostream>
 #include <cmath>
+#include <limits>
 #include <ostream>
 
-class Vec3{
+// Float vectors get a fourth, always zero lane and 16 byte alignment so one vector is one SSE or //
+// NEON register, and the operators below have intrinsic versions for them. Doubles, and floats //
+// with RT_NO_SIMD, stay three plain scalars. //
+#if !defined(RT_NO_SIMD) && (defined(__SSE__) || defined(_M_X64))
+#include <xmmintrin.h>
+#define VEC3_SSE
+#elif !defined(RT_NO_SIMD) && defined(__ARM_NEON)
+#include <arm_neon.h>
+#define VEC3_NEON
+#endif
+
+template <typename T>
+struct Vec3_layout{
+    static constexpr int lanes = 3;
+    static constexpr std::size_t alignment = alignof(T);
+};
+
+#if defined(VEC3_SSE) || defined(VEC3_NEON)
+template <>
+struct Vec3_layout<float>{
+    static constexpr int lanes = 4;
+    static constexpr std::size_t alignment = 16;
+};
+#endif
+
+template <typename T>
+class alignas(Vec3_layout<T>::alignment) Vec3_t{
     public:
-    double e[3];
+    using scalar = T;
+    static constexpr int lanes = Vec3_layout<T>::lanes;
+    T e[lanes];
 
     // Define constructors //
-    Vec3(){
-        e[0] = 0;
-        e[1] = 0;
-        e[2] = 0;
+    Vec3_t(){
+        for(int k=0; k<lanes; k++){
+            e[k] = 0;
+        }
     }
-    Vec3(double e0, double e1, double e2){
+    Vec3_t(T e0, T e1, T e2){
         e[0] = e0;
         e[1] = e1;
         e[2] = e2;
+        for(int k=3; k<lanes; k++){
+            e[k] = 0;
+        }
     }
 
     // Create operator functions //
-    double x() const{
+    T x() const{
         return e[0];
     }
 
-    double y() const{
+    T y() const{
         return e[1];
     }
 
-    double z() const{
+    T z() const{
         return e[2];
     }
 
-    Vec3 operator-() const{
-        return Vec3(-e[0], -e[1], -e[2]);
+    Vec3_t operator-() const{
+        return Vec3_t(-e[0], -e[1], -e[2]);
     }
 
-    double operator[](int i) const{
+    T operator[](int i) const{
         return e[i];
     }
 
-    double& operator[](int i){
+    T& operator[](int i){
         return e[i];
     }
 
-    Vec3& operator+=(const Vec3& v){
-        e[0] += v[0];
-        e[1] += v[1];
-        e[2] += v[2];
-
-        return *this;
+    // The compound operators go through the free ones so they pick up the SIMD versions //
+    Vec3_t& operator+=(const Vec3_t& v){
+        return *this = *this + v;
     }
 
-    Vec3& operator*=(double x){
-        e[0] *= x;
-        e[1] *= x;
-        e[2] *= x;
-
-        return *this;
+    Vec3_t& operator*=(T x){
+        return *this = *this * x;
     }
 
-    Vec3& operator/=(double t){
+    Vec3_t& operator/=(T t){
         return *this *= 1/t;
     }
 
-    double length() const{
+    T length() const{
         return std::sqrt(length_squared());
     }
 
-    double length_squared() const{
-        return e[0]*e[0] + e[1]*e[1] + e[2]*e[2];
+    T length_squared() const{
+        return dot(*this, *this);
     }
 
     bool near_zero() const {
         // Return true if the vector is close to zero in all dimensions.
-        auto s = 1e-8;
+        auto s = T(1e-8);
         return (std::fabs(e[0]) < s) && (std::fabs(e[1]) < s) && (std::fabs(e[2]) < s);
     }
 
-    static Vec3 random(){
-        return Vec3(random_double(), random_double(), random_double());
+    static Vec3_t random(){
+        return Vec3_t(T(random_double()), T(random_double()), T(random_double()));
     }
 
-    static Vec3 random(double min, double max){
-        return Vec3(random_double(min, max), random_double(min, max), random_double(min, max));
+    static Vec3_t random(double min, double max){
+        return Vec3_t(T(random_double(min, max)), T(random_double(min, max)), T(random_double(min, max)));
     }
 };
 
+// The vector type used everywhere, its scalar follows RT_SINGLE_PRECISION //
+using Vec3 = Vec3_t<real>;
+
 // Creating alias of Vec3 named Point3 //
 using Point3 = Vec3;
 
+// Scalar arguments take the vector's scalar type without deducing it, so 2 * v or v / count //
+// convert the number instead of failing to match //
+template <typename T>
+using Scalar_of = typename Vec3_t<T>::scalar;
+
 // Creating utility functions //
-inline std::ostream& operator<<(std::ostream& out, const Vec3& v){
+template <typename T>
+inline std::ostream& operator<<(std::ostream& out, const Vec3_t<T>& v){
     return out << v[0] << "," << v[1] << "," << v[2];
 }
 
-inline Vec3 operator+(const Vec3& u, const Vec3& v){
-    return Vec3(u[0]+v[0], u[1]+v[1], u[2]+v[2]);
+template <typename T>
+inline Vec3_t<T> operator+(const Vec3_t<T>& u, const Vec3_t<T>& v){
+    return Vec3_t<T>(u[0]+v[0], u[1]+v[1], u[2]+v[2]);
 }
 
-inline Vec3 operator-(const Vec3& u, const Vec3& v){
-    return Vec3(u[0]-v[0], u[1]-v[1], u[2]-v[2]);
+template <typename T>
+inline Vec3_t<T> operator-(const Vec3_t<T>& u, const Vec3_t<T>& v){
+    return Vec3_t<T>(u[0]-v[0], u[1]-v[1], u[2]-v[2]);
 }
 
-inline Vec3 operator*(const Vec3& u, const Vec3& v){
-    return Vec3(u[0]*v[0], u[1]*v[1], u[2]*v[2]);
+template <typename T>
+inline Vec3_t<T> operator*(const Vec3_t<T>& u, const Vec3_t<T>& v){
+    return Vec3_t<T>(u[0]*v[0], u[1]*v[1], u[2]*v[2]);
 }
 
-inline Vec3 operator*(double t, const Vec3& v){
-    return Vec3(v[0]*t, v[1]*t, v[2]*t);
+template <typename T>
+inline Vec3_t<T> operator*(Scalar_of<T> t, const Vec3_t<T>& v){
+    return Vec3_t<T>(v[0]*t, v[1]*t, v[2]*t);
 }
 
-inline Vec3 operator*(const Vec3& v, double t){
+template <typename T>
+inline Vec3_t<T> operator*(const Vec3_t<T>& v, Scalar_of<T> t){
     return t * v;
 }
 
-inline Vec3 operator/(const Vec3& v, double t){
+template <typename T>
+inline Vec3_t<T> operator/(const Vec3_t<T>& v, Scalar_of<T> t){
     return (1/t) * v;
 }
 
-inline double dot(const Vec3& u, const Vec3& v){
+template <typename T>
+inline T dot(const Vec3_t<T>& u, const Vec3_t<T>& v){
     return u[0]*v[0] + u[1]*v[1] + u[2]*v[2];
 }
 
-inline Vec3 cross(const Vec3& u, const Vec3& v) {
-    return Vec3(u[1] * v[2] - u[2] * v[1],
-                u[2] * v[0] - u[0] * v[2],
-                u[0] * v[1] - u[1] * v[0]);
+template <typename T>
+inline Vec3_t<T> cross(const Vec3_t<T>& u, const Vec3_t<T>& v) {
+    return Vec3_t<T>(u[1] * v[2] - u[2] * v[1],
+                     u[2] * v[0] - u[0] * v[2],
+                     u[0] * v[1] - u[1] * v[0]);
 }
 
-inline Vec3 unit_vector(const Vec3& v){
+template <typename T>
+inline Vec3_t<T> unit_vector(const Vec3_t<T>& v){
     return v / v.length();
 }
 
-inline Vec3 random_unit_vector() {
-    while (true) {
-        auto p = Vec3::random(-1,1);
-        auto lensq = p.length_squared();
-        if (1e-160 < lensq && lensq <= 1)
-            return p / sqrt(lensq);
+// Float4 versions, preferred over the templates above as exact non-template matches. //
+// The fourth lane is zero on the way in and every operation keeps it zero or ignores it. //
+#if defined(VEC3_SSE)
+inline __m128 vec3_load(const Vec3_t<float>& v){
+    return _mm_load_ps(v.e);
+}
+
+inline Vec3_t<float> vec3_store(__m128 x){
+    Vec3_t<float> v;
+    _mm_store_ps(v.e, x);
+    return v;
+}
+
+inline Vec3_t<float> operator+(const Vec3_t<float>& u, const Vec3_t<float>& v){
+    return vec3_store(_mm_add_ps(vec3_load(u), vec3_load(v)));
+}
+
+inline Vec3_t<float> operator-(const Vec3_t<float>& u, const Vec3_t<float>& v){
+    return vec3_store(_mm_sub_ps(vec3_load(u), vec3_load(v)));
+}
+
+inline Vec3_t<float> operator*(const Vec3_t<float>& u, const Vec3_t<float>& v){
+    return vec3_store(_mm_mul_ps(vec3_load(u), vec3_load(v)));
+}
+
+inline Vec3_t<float> operator*(float t, const Vec3_t<float>& v){
+    return vec3_store(_mm_mul_ps(vec3_load(v), _mm_set1_ps(t)));
+}
+
+inline Vec3_t<float> operator*(const Vec3_t<float>& v, float t){
+    return t * v;
+}
+
+inline Vec3_t<float> operator/(const Vec3_t<float>& v, float t){
+    return (1/t) * v;
+}
+
+inline float dot(const Vec3_t<float>& u, const Vec3_t<float>& v){
+    // Sum of the first three lanes only, the fourth may hold NaN after 0 * inf //
+    __m128 m = _mm_mul_ps(vec3_load(u), vec3_load(v));
+    __m128 y = _mm_shuffle_ps(m, m, _MM_SHUFFLE(1, 1, 1, 1));
+    __m128 z = _mm_shuffle_ps(m, m, _MM_SHUFFLE(2, 2, 2, 2));
+    return _mm_cvtss_f32(_mm_add_ss(_mm_add_ss(m, y), z));
+}
+
+inline Vec3_t<float> cross(const Vec3_t<float>& u, const Vec3_t<float>& v){
+    // u * v.yzx - u.yzx * v gives the cross product in zxy order, one more shuffle puts it back //
+    __m128 a = vec3_load(u);
+    __m128 b = vec3_load(v);
+    __m128 a_yzx = _mm_shuffle_ps(a, a, _MM_SHUFFLE(3, 0, 2, 1));
+    __m128 b_yzx = _mm_shuffle_ps(b, b, _MM_SHUFFLE(3, 0, 2, 1));
+    __m128 c = _mm_sub_ps(_mm_mul_ps(a, b_yzx), _mm_mul_ps(a_yzx, b));
+    return vec3_store(_mm_shuffle_ps(c, c, _MM_SHUFFLE(3, 0, 2, 1)));
+}
+
+inline Vec3_t<float> unit_vector(const Vec3_t<float>& v){
+    return vec3_store(_mm_div_ps(vec3_load(v), _mm_sqrt_ps(_mm_set1_ps(dot(v, v)))));
+}
+#elif defined(VEC3_NEON)
+inline float32x4_t vec3_load(const Vec3_t<float>& v){
+    return vld1q_f32(v.e);
+}
+
+inline Vec3_t<float> vec3_store(float32x4_t x){
+    Vec3_t<float> v;
+    vst1q_f32(v.e, x);
+    return v;
+}
+
+inline Vec3_t<float> operator+(const Vec3_t<float>& u, const Vec3_t<float>& v){
+    return vec3_store(vaddq_f32(vec3_load(u), vec3_load(v)));
+}
+
+inline Vec3_t<float> operator-(const Vec3_t<float>& u, const Vec3_t<float>& v){
+    return vec3_store(vsubq_f32(vec3_load(u), vec3_load(v)));
+}
+
+inline Vec3_t<float> operator*(const Vec3_t<float>& u, const Vec3_t<float>& v){
+    return vec3_store(vmulq_f32(vec3_load(u), vec3_load(v)));
+}
+
+inline Vec3_t<float> operator*(float t, const Vec3_t<float>& v){
+    return vec3_store(vmulq_n_f32(vec3_load(v), t));
+}
+
+inline Vec3_t<float> operator*(const Vec3_t<float>& v, float t){
+    return t * v;
+}
+
+inline Vec3_t<float> operator/(const Vec3_t<float>& v, float t){
+    return (1/t) * v;
+}
+
+inline float dot(const Vec3_t<float>& u, const Vec3_t<float>& v){
+    // Sum of the first three lanes only, the fourth may hold NaN after 0 * inf //
+    float32x4_t m = vmulq_f32(vec3_load(u), vec3_load(v));
+    return vgetq_lane_f32(m, 0) + vgetq_lane_f32(m, 1) + vgetq_lane_f32(m, 2);
+}
+
+inline Vec3_t<float> cross(const Vec3_t<float>& u, const Vec3_t<float>& v){
+    // Rotate to yzx order with lane extracts: (y, z, w, x) then swap in x for w //
+    float32x4_t a = vec3_load(u);
+    float32x4_t b = vec3_load(v);
+    float32x4_t a_yzx = vsetq_lane_f32(vgetq_lane_f32(a, 0), vextq_f32(a, a, 1), 2);
+    float32x4_t b_yzx = vsetq_lane_f32(vgetq_lane_f32(b, 0), vextq_f32(b, b, 1), 2);
+    float32x4_t c = vsubq_f32(vmulq_f32(a, b_yzx), vmulq_f32(a_yzx, b));
+    float32x4_t c_yzx = vsetq_lane_f32(vgetq_lane_f32(c, 0), vextq_f32(c, c, 1), 2);
+    return vec3_store(vsetq_lane_f32(0.0f, c_yzx, 3));
+}
+
+inline Vec3_t<float> unit_vector(const Vec3_t<float>& v){
+    return (1 / std::sqrt(dot(v, v))) * v;
+}
+#endif
+
+// Closed form maps from the unit square to directions and disk points. Each draws exactly two //
+// numbers and has no loop or branch on them: selects compile to blends and sin/cos come from a //
+// polynomial, so the component versions vectorize over arrays of samples (with -fno-math-errno, //
+// which the builds set, so sqrt needs no errno branch), see the batch versions below. Scalars //
+// are float or double. //
+
+// sin and cos of 2*pi*t for t >= -1/8: t is rounded to the nearest quarter turn, the rest (at most //
+// an eighth of a turn) goes through Taylor polynomials good to about 2e-9, and the quarter turns //
+// swap and negate //
+template <typename T>
+inline void sincos_turns(T t, T& s, T& c){
+    T quarters = 4 * t;
+    int q = int(quarters + T(0.5)); //rounds, quarters + 1/2 >= 0//
+    T x = (quarters - T(q)) * T(pi / 2);
+    T x2 = x * x;
+    T sin_x = x * (1 + x2 * (T(-1.0/6) + x2 * (T(1.0/120) + x2 * (T(-1.0/5040) + x2 * T(1.0/362880)))));
+    T cos_x = 1 + x2 * (T(-0.5) + x2 * (T(1.0/24) + x2 * (T(-1.0/720) + x2 * (T(1.0/40320) + x2 * T(-1.0/3628800)))));
+    T a = (q & 1) ? cos_x : sin_x;
+    T b = (q & 1) ? sin_x : cos_x;
+    s = (q & 2) ? -a : a;
+    c = ((q + 1) & 2) ? -b : b;
+}
+
+// Uniform on the unit sphere: z uniform in [-1, 1], the azimuth uniform //
+template <typename T>
+inline void square_to_sphere(T u, T v, T& x, T& y, T& z){
+    z = 1 - 2 * u;
+    T r2 = 1 - z*z;
+    T r = std::sqrt(r2 > 0 ? r2 : T(0));
+    T s, c;
+    sincos_turns(v, s, c);
+    x = r * c;
+    y = r * s;
+}
+
+// Uniform on the unit disk by the concentric map (Shirley and Chiu 1997), which keeps strata of //
+// the square compact. The two cases are blended by wide = 0 or 1, exact either way; selects would //
+// let the compiler move the division into two branches. |den| >= |num|, and both are 0 only at //
+// the center, where the tiny offset stands in for another branch. //
+template <typename T>
+inline void square_to_disk(T u, T v, T& x, T& y){
+    T a = 2 * u - 1, b = 2 * v - 1;
+    T wide = std::isgreater(a*a, b*b) ? T(1) : T(0);
+    T narrow = 1 - wide;
+    T r = wide * a + narrow * b;
+    T num = wide * b + narrow * a;
+    T den = wide * a + narrow * b;
+    T ratio = num / (den + std::copysign(std::numeric_limits<T>::min(), den));
+    T turns = wide * (ratio / 8) + narrow * (T(0.25) - ratio / 8);
+    T s, c;
+    sincos_turns(turns, s, c);
+    x = r * c;
+    y = r * s;
+}
+
+// Cosine weighted about +z: a disk point lifted onto the hemisphere (Malley's method) //
+template <typename T>
+inline void square_to_cosine_hemisphere(T u, T v, T& x, T& y, T& z){
+    square_to_disk(u, v, x, y);
+    T z2 = 1 - x*x - y*y;
+    z = std::sqrt(z2 > 0 ? z2 : T(0));
+}
+
+inline Vec3 sphere_direction(double u, double v){
+    real x, y, z;
+    square_to_sphere(real(u), real(v), x, y, z);
+    return Vec3(x, y, z);
+}
+
+inline Vec3 disk_point(double u, double v){
+    real x, y;
+    square_to_disk(real(u), real(v), x, y);
+    return Vec3(x, y, 0);
+}
+
+// Cosine weighted direction about +z, to be turned into world space with an Onb //
+inline Vec3 cosine_direction(double u, double v){
+    real x, y, z;
+    square_to_cosine_hemisphere(real(u), real(v), x, y, z);
+    return Vec3(x, y, z);
+}
+
+// Batch versions over arrays of samples, structure of arrays so the loops vectorize //
+template <typename T>
+inline void square_to_sphere(const T* u, const T* v, T* x, T* y, T* z, size_t count){
+    for(size_t k=0; k<count; k++){
+        square_to_sphere(u[k], v[k], x[k], y[k], z[k]);
     }
 }
 
+template <typename T>
+inline void square_to_disk(const T* u, const T* v, T* x, T* y, size_t count){
+    for(size_t k=0; k<count; k++){
+        square_to_disk(u[k], v[k], x[k], y[k]);
+    }
+}
+
+template <typename T>
+inline void square_to_cosine_hemisphere(const T* u, const T* v, T* x, T* y, T* z, size_t count){
+    for(size_t k=0; k<count; k++){
+        square_to_cosine_hemisphere(u[k], v[k], x[k], y[k], z[k]);
+    }
+}
+
+// The two numbers are drawn in separate statements, argument evaluation order is unspecified //
+inline Vec3 random_unit_vector(){
+    double u = random_double();
+    double v = random_double();
+    return sphere_direction(u, v);
+}
+
 inline Vec3 random_on_hemisphere(const Vec3& normal) {
     Vec3 on_unit_sphere = random_unit_vector();
-    double dot_product = dot(on_unit_sphere, normal);
+    real dot_product = dot(on_unit_sphere, normal);
     if (dot_product > 0.0) // In the same hemisphere as the normal
         return on_unit_sphere;
     else
@@ -155,25 +416,22 @@ inline Vec3 random_on_hemisphere(const Vec3& normal) {
 }
 
 inline Vec3 random_in_unit_disk(){
-    while(true){
-        auto p = Vec3(random_double(-1,1), random_double(-1,1),0);
-        if(p.length_squared() < 1){
-            return p;
-        }
-    }
+    double u = random_double();
+    double v = random_double();
+    return disk_point(u, v);
 }
 
 inline Vec3 reflect(const Vec3& v, const Vec3& n){
     return v - 2 * dot(v, n) * n;
 }
 
-inline Vec3 refract(const Vec3& uv, const Vec3& n, double etai_over_etat){
+inline Vec3 refract(const Vec3& uv, const Vec3& n, real etai_over_etat){
     //calculate r perpendicular//
-    auto cos_theta = std::fmin(dot(-uv, n), 1.0);
+    auto cos_theta = std::fmin(dot(-uv, n), real(1.0));
     Vec3 r_out_perp = etai_over_etat * (uv + cos_theta*n);
 
     //calculate r parallel//
-    Vec3 r_out_parallel = -std::sqrt(std::fabs(1.0 - r_out_perp.length_squared()))*n;
+    Vec3 r_out_parallel = -std::sqrt(std::fabs(real(1.0) - r_out_perp.length_squared()))*n;
 
     return r_out_perp + r_out_parallel;
 }
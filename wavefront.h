@@ -0,0 +1,124 @@
+#ifndef WAVEFRONT_H
+#define WAVEFRONT_H
+
+#include "color.h"
+#include "hittable.h"
+#include "material.h"
+#include "ray.h"
+#include "rtweekend.h"
+#include "sampler.h"
+#include <cstdint>
+#include <typeindex>
+#include <typeinfo>
+#include <vector>
+
+// State of one camera path between bounces //
+struct Wavefront_path{
+    Ray ray;
+    Color3 throughput;
+    Color3 radiance; //light gathered so far//
+    double scatter_pdf; //density the last scatter picked ray with, 0 where light sampling could not//
+    Rng rng; //the path's own random stream, swapped in while it scatters//
+    Sample_state sample; //its place in the sampler, swapped in with rng//
+    std::uint32_t slot; //where the path's final color goes//
+};
+
+// Queue of paths advanced one bounce at a time for the whole queue: intersect every path, //
+// group the hits by material type, then scatter each group in one run so the same code //
+// stays hot, and finally drop the paths that ended. //
+class Wavefront_queue{
+    private:
+    static constexpr std::uint32_t no_kind = ~std::uint32_t(0);
+    std::vector<std::type_index> kinds; //material types seen so far, their position is the group id//
+    std::vector<std::uint32_t> material_kind; //group id of each material, filled on first use per intersect//
+
+    template <typename Scene_type>
+    std::uint32_t kind_of(const Scene_type& scene, Material_id mat){
+        if(material_kind[mat] != no_kind){
+            return material_kind[mat];
+        }
+        std::type_index kind = scene.material_type(mat);
+        std::uint32_t k = 0;
+        while(k < kinds.size() && kinds[k] != kind){
+            k++;
+        }
+        if(k == kinds.size()){
+            kinds.push_back(kind);
+        }
+        material_kind[mat] = k;
+        return k;
+    }
+
+    public:
+    std::vector<Wavefront_path> paths;
+    std::vector<Hit_record> hits; //closest hit of each path, valid where hit_any is set//
+    std::vector<char> hit_any;
+    std::vector<char> alive;
+    std::vector<std::uint32_t> order; //paths that hit something, grouped by material type//
+    std::vector<std::uint32_t> misses; //paths that left the scene//
+
+    void clear(){
+        paths.clear();
+    }
+
+    bool empty() const{
+        return paths.empty();
+    }
+
+    // Find the closest hit of every path and sort the paths into material groups and misses //
+    template <typename Scene_type>
+    void intersect(const Scene_type& scene, Interval ray_t){
+        size_t count = paths.size();
+        hits.resize(count);
+        hit_any.assign(count, 0);
+        alive.assign(count, 1);
+        for(size_t k=0; k<count; k++){
+            hit_any[k] = scene.hit(paths[k].ray, ray_t, hits[k]);
+        }
+
+        // Counting sort by material type, keeping path order inside each group //
+        std::vector<std::uint32_t> kind(count);
+        std::vector<std::uint32_t> group_start;
+        material_kind.assign(scene.material_count(), no_kind);
+        misses.clear();
+        for(size_t k=0; k<count; k++){
+            if(!hit_any[k]){
+                misses.push_back(std::uint32_t(k));
+                continue;
+            }
+            kind[k] = kind_of(scene, hits[k].mat);
+            if(group_start.size() <= kind[k]){
+                group_start.resize(kind[k] + 1, 0);
+            }
+            group_start[kind[k]]++;
+        }
+        std::uint32_t offset = 0;
+        for(auto& start : group_start){
+            auto size = start;
+            start = offset;
+            offset += size;
+        }
+        order.resize(offset);
+        for(size_t k=0; k<count; k++){
+            if(hit_any[k]){
+                order[group_start[kind[k]]++] = std::uint32_t(k);
+            }
+        }
+    }
+
+    // Remove the paths marked dead, keeping the survivors in order //
+    void compact(){
+        size_t kept = 0;
+        for(size_t k=0; k<paths.size(); k++){
+            if(alive[k]){
+                if(kept != k){
+                    paths[kept] = paths[k];
+                }
+                kept++;
+            }
+        }
+        paths.resize(kept);
+    }
+};
+
+#endif